@@ -84,8 +84,8 @@ fill_search_spaces( const World* world ){
       delete _search_spaces[ i ].second;
       _search_spaces[ i ].second = NULL;
     }
-    _search_spaces.clear();
   }
+  _search_spaces.clear();
 
   for( unsigned int i = 0; i < _correspondence_variables.size(); i++ ){
     _correspondence_variables[ i ].clear();
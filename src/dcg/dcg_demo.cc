@@ -69,7 +69,10 @@ main( int argc,
   Feature_Set * feature_set = new Feature_Set();
   LLM * llm = new LLM( feature_set );
   if( args.llm_given ){
-    llm->from_xml( args.llm_arg );
+    if( !llm->from_file( args.llm_arg ) ){
+      cout << "could not read llm from " << args.llm_arg << endl;
+      exit(1);
+    }
   }
 
   DCG * dcg = new DCG();
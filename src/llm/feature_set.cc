@@ -31,6 +31,10 @@
  * The implementation of a class used to describe a set of features
  */
 
+#include <sstream>
+#include <cstdlib>
+#include <boost/crc.hpp>
+
 #include "h2sl/feature_word.h"
 #include "h2sl/feature_num_words.h"
 #include "h2sl/feature_cv.h"
@@ -50,8 +54,25 @@
 using namespace std;
 using namespace h2sl;
 
+/**
+ * maps an index of a feature product into a slot of a hashed weight table of the given size
+ */
+inline unsigned int
+hash_index( const unsigned int& product,
+            const unsigned int& index,
+            const unsigned int& hashSize ){
+  unsigned long long key = ( ( unsigned long long )( product ) << 32 ) | index;
+  key ^= key >> 30;
+  key *= 0xbf58476d1ce4e5b9ULL;
+  key ^= key >> 27;
+  key *= 0x94d049bb133111ebULL;
+  key ^= key >> 31;
+  return ( unsigned int )( key % hashSize );
+}
+
 Feature_Set::
-Feature_Set() : _feature_products() {
+Feature_Set() : _feature_products(),
+                _hash_size( 0 ) {
 
 }
 
@@ -61,7 +82,8 @@ Feature_Set::
 }
 
 Feature_Set::
-Feature_Set( const Feature_Set& other ) : _feature_products( other._feature_products ) {
+Feature_Set( const Feature_Set& other ) : _feature_products( other._feature_products ),
+                                          _hash_size( other._hash_size ) {
 
 }
 
@@ -69,6 +91,7 @@ Feature_Set&
 Feature_Set::
 operator=( const Feature_Set& other ) {
   _feature_products = other._feature_products;
+  _hash_size = other._hash_size;
   return (*this);
 }
 
@@ -100,8 +123,14 @@ indices( const unsigned int& cv,
     }
     cout << "}" << endl; 
 */
-    for( unsigned int j = 0; j < product_indices.size(); j++ ){
-      indices.push_back( product_indices[ j ] + offset );
+    if( _hash_size > 0 ){
+      for( unsigned int j = 0; j < product_indices.size(); j++ ){
+        indices.push_back( hash_index( i, product_indices[ j ], _hash_size ) );
+      }
+    } else {
+      for( unsigned int j = 0; j < product_indices.size(); j++ ){
+        indices.push_back( product_indices[ j ] + offset );
+      }
     }
     offset += _feature_products[ i ]->size();
   }
@@ -178,6 +207,11 @@ Feature_Set::
 to_xml( xmlDocPtr doc, 
         xmlNodePtr root )const{
   xmlNodePtr node = xmlNewDocNode( doc, NULL, ( xmlChar* )( "feature_set" ), NULL );
+  if( _hash_size > 0 ){
+    stringstream hash_size_string;
+    hash_size_string << _hash_size;
+    xmlNewProp( node, ( const xmlChar* )( "hash_size" ), ( const xmlChar* )( hash_size_string.str().c_str() ) );
+  }
   for( unsigned int i = 0; i < _feature_products.size(); i++ ){
     _feature_products[ i ]->to_xml( doc, node );
   }
@@ -218,8 +252,14 @@ from_xml( xmlNodePtr root ){
     }
   }
   _feature_products.clear();
+  _hash_size = 0;
 
   if( root->type == XML_ELEMENT_NODE ){
+    xmlChar * tmp = xmlGetProp( root, ( const xmlChar* )( "hash_size" ) );
+    if( tmp != NULL ){
+      _hash_size = strtoul( ( char* )( tmp ), NULL, 10 );
+      xmlFree( tmp );
+    }
     xmlNodePtr l1 = NULL;
     for( l1 = root->children; l1; l1 = l1->next ){
       if( l1->type == XML_ELEMENT_NODE ){
@@ -233,9 +273,24 @@ from_xml( xmlNodePtr root ){
   return;
 }
 
+/**
+ * returns the number of weights, which is the size of the hashed weight table when hashing is enabled
+ */
 unsigned int
 Feature_Set::
 size( void )const{
+  if( _hash_size > 0 ){
+    return _hash_size;
+  }
+  return num_features();
+}
+
+/**
+ * returns the number of distinct features, the sum of the sizes of the feature products
+ */
+unsigned int
+Feature_Set::
+num_features( void )const{
   unsigned int tmp = 0;
   for( unsigned int i = 0; i < _feature_products.size(); i++ ){
     tmp += _feature_products[ i ]->size();
@@ -243,6 +298,26 @@ size( void )const{
   return tmp;
 }
 
+/**
+ * returns the CRC-32 of the serialized feature set, used to check that weights were trained for this feature set
+ */
+unsigned int
+Feature_Set::
+checksum( void )const{
+  xmlDocPtr doc = xmlNewDoc( ( xmlChar* )( "1.0" ) );
+  xmlNodePtr root = xmlNewDocNode( doc, NULL, ( xmlChar* )( "root" ), NULL );
+  xmlDocSetRootElement( doc, root );
+  to_xml( doc, root );
+  xmlChar * buffer = NULL;
+  int buffer_size = 0;
+  xmlDocDumpMemory( doc, &buffer, &buffer_size );
+  boost::crc_32_type crc;
+  crc.process_bytes( buffer, buffer_size );
+  xmlFree( buffer );
+  xmlFreeDoc( doc );
+  return crc.checksum();
+}
+
 namespace h2sl {
   ostream&
   operator<<( ostream& out,
@@ -60,12 +60,17 @@ namespace h2sl {
     virtual void from_xml( xmlNodePtr root );
 
     unsigned int size( void )const;
+    unsigned int num_features( void )const;
+    unsigned int checksum( void )const;
 
     inline std::vector< Feature_Product* >& feature_products( void ){ return _feature_products; };
     inline const std::vector< Feature_Product* >& feature_products( void )const{ return _feature_products; };
+    inline unsigned int& hash_size( void ){ return _hash_size; };
+    inline const unsigned int& hash_size( void )const{ return _hash_size; };
 
   protected:
     std::vector< Feature_Product* > _feature_products;
+    unsigned int _hash_size;
 
   private:
 
@@ -35,15 +35,28 @@
 #define H2SL_LLM_H
 
 #include <iostream>
+#include <fstream>
 #include <vector>
 #include <map>
+#include <deque>
 #include <libxml/tree.h>
+#include <boost/shared_ptr.hpp>
 
 #include <h2sl/grounding.h>
 #include <h2sl/cv.h>
 #include <h2sl/feature_set.h>
+#include <h2sl/thread_pool.h>
+#include <h2sl/telemetry.h>
+#include <h2sl/process_group.h>
 
 namespace h2sl {
+  typedef enum {
+    LLM_TRAIN_OPTIMIZER_LBFGS,
+    LLM_TRAIN_OPTIMIZER_SGD,
+    LLM_TRAIN_OPTIMIZER_ADAGRAD,
+    NUM_LLM_TRAIN_OPTIMIZERS
+  } llm_train_optimizer_t;
+
   class LLM_X {
   public:
     LLM_X( const Grounding* grounding, const Phrase* phrase, const World* world, const std::vector< unsigned int >& cvs, const std::vector< Feature* >& features, const std::string& filename );
@@ -65,12 +78,224 @@ namespace h2sl {
     std::vector< std::pair< const Phrase*, std::vector< Grounding* > > > _children;
     const Phrase * _phrase;
     const World * _world;
-    const std::vector< unsigned int >& _cvs;
+    std::vector< unsigned int > _cvs;
     std::vector< Feature* > _features;
-    const std::string& _filename;
+    std::string _filename;
   };
   std::ostream& operator<<( std::ostream& out, const LLM_X& other );
 
+  typedef struct {
+    unsigned int cv;
+    unsigned int world;
+    unsigned int phrase;
+    unsigned int grounding;
+    unsigned int cvs;
+    unsigned int children;
+    unsigned int num_children;
+  } llm_example_t;
+
+  typedef struct {
+    unsigned int phrase;
+    unsigned int groundings;
+    unsigned int num_groundings;
+  } llm_example_child_t;
+
+  /**
+   * training examples stored as plain records of integer ids into tables of the worlds, phrases, 
+   * groundings and correspondence variable sets they refer to; the children of a phrase are stored 
+   * once in a shared child table that every example of the phrase points into
+   */
+  class LLM_Example_Set {
+  public:
+    LLM_Example_Set();
+    virtual ~LLM_Example_Set();
+    LLM_Example_Set( const LLM_Example_Set& other );
+    LLM_Example_Set& operator=( const LLM_Example_Set& other );
+
+    void clear( void );
+    unsigned int world_id( const World* world, const std::string& filename );
+    unsigned int phrase_id( const Phrase* phrase );
+    unsigned int grounding_id( Grounding* grounding );
+    unsigned int cvs_id( const std::vector< unsigned int >& cvs );
+    unsigned int add_children( const std::vector< std::pair< const Phrase*, std::vector< Grounding* > > >& children );
+    void children( const llm_example_t& example, std::vector< std::pair< const Phrase*, std::vector< Grounding* > > >& children )const;
+    void scrape( const std::string& filename, const Phrase* phrase, const World* world, const std::vector< std::pair< unsigned int, Grounding* > >& searchSpaces, const std::vector< std::vector< unsigned int > >& correspondenceVariables );
+
+    inline void push_back( const llm_example_t& example ){ _examples.push_back( example ); };
+    inline unsigned int size( void )const{ return _examples.size(); };
+    inline bool empty( void )const{ return _examples.empty(); };
+    inline const llm_example_t& operator[]( const unsigned int& i )const{ return _examples[ i ]; };
+    inline const World* world( const unsigned int& id )const{ return _worlds[ id ]; };
+    inline const std::string& filename( const unsigned int& id )const{ return _filenames[ id ]; };
+    inline const Phrase* phrase( const unsigned int& id )const{ return _phrases[ id ]; };
+    inline const Grounding* grounding( const unsigned int& id )const{ return _groundings[ id ]; };
+    inline const std::vector< unsigned int >& cvs( const unsigned int& id )const{ return _cv_sets[ id ]; };
+    inline unsigned int num_phrases( void )const{ return _phrases.size(); };
+
+  protected:
+    std::vector< llm_example_t > _examples;
+    std::vector< llm_example_child_t > _children;
+    std::vector< unsigned int > _child_groundings;
+    std::vector< const World* > _worlds;
+    std::vector< std::string > _filenames;
+    std::vector< const Phrase* > _phrases;
+    std::vector< Grounding* > _groundings;
+    std::vector< std::vector< unsigned int > > _cv_sets;
+    std::map< const World*, unsigned int > _world_ids;
+    std::map< const Phrase*, unsigned int > _phrase_ids;
+    std::map< const Grounding*, unsigned int > _grounding_ids;
+    std::map< std::vector< unsigned int >, unsigned int > _cvs_ids;
+  };
+
+  /**
+   * a read-only mapping of a range of bytes of the concatenation of one or more files into one 
+   * contiguous range of addresses; every file but the last must be a multiple of the page size
+   */
+  class LLM_Index_Table_Region {
+  public:
+    LLM_Index_Table_Region();
+    virtual ~LLM_Index_Table_Region();
+
+    bool map( const std::vector< std::string >& filenames, const unsigned long long& offset, const unsigned long long& size );
+    void unmap( void );
+
+    inline const void* data( void )const{ return _data; };
+    inline const unsigned long long& size( void )const{ return _size; };
+
+  protected:
+    void * _address;
+    unsigned long long _length;
+    const void * _data;
+    unsigned long long _size;
+
+  private:
+    LLM_Index_Table_Region( const LLM_Index_Table_Region& other );
+    LLM_Index_Table_Region& operator=( const LLM_Index_Table_Region& other );
+  };
+
+  /**
+   * compressed-sparse-row storage of the feature indices of a set of examples; row r owns
+   * cv_offsets()[ example_offsets()[ r ] ] ... cv_offsets()[ example_offsets()[ r + 1 ] ] in values().
+   * the offsets are 64-bit so that a table can hold more than 2^32 indices or correspondence variables.
+   * the arrays are either held in memory or mapped, from the shard files of an LLM_Index_Table_Writer 
+   * or from an index cache written by write()
+   */
+  class LLM_Index_Table {
+  public:
+    LLM_Index_Table();
+    virtual ~LLM_Index_Table();
+    LLM_Index_Table( const LLM_Index_Table& other );
+    LLM_Index_Table& operator=( const LLM_Index_Table& other );
+
+    void clear( void );
+    void push_row( void );
+    void push_cv( const std::vector< unsigned int >& indices );
+    void append( const LLM_Index_Table& other );
+
+    bool read( const std::string& filename, const std::string& key );
+    bool write( const std::string& filename, const std::string& key )const;
+    bool map( const std::string& prefix );
+    bool map( const std::string& filename, const std::string& key );
+    void prefetch( const unsigned int& begin, const unsigned int& end )const;
+
+    inline bool mapped( void )const{ return !_regions.empty(); };
+    inline unsigned int num_rows( void )const{ return _num_rows; };
+    inline unsigned long long num_cvs( void )const{ return _example_offsets_data[ _num_rows ]; };
+    inline unsigned long long num_values( void )const{ return _cv_offsets_data[ num_cvs() ]; };
+    inline unsigned int num_cvs( const unsigned int& row )const{ return _example_offsets_data[ row + 1 ] - _example_offsets_data[ row ]; };
+    inline unsigned int num_values( const unsigned int& row )const{ return _cv_offsets_data[ _example_offsets_data[ row + 1 ] ] - _cv_offsets_data[ _example_offsets_data[ row ] ]; };
+    inline const unsigned int* begin( const unsigned int& row, const unsigned int& cv )const{ return _values_data + _cv_offsets_data[ _example_offsets_data[ row ] + cv ]; };
+    inline const unsigned int* end( const unsigned int& row, const unsigned int& cv )const{ return _values_data + _cv_offsets_data[ _example_offsets_data[ row ] + cv + 1 ]; };
+
+    inline const unsigned int* values( void )const{ return _values_data; };
+    inline const unsigned long long* cv_offsets( void )const{ return _cv_offsets_data; };
+    inline const unsigned long long* example_offsets( void )const{ return _example_offsets_data; };
+
+  protected:
+    void _sync( void );
+
+    std::vector< unsigned int > _values;
+    std::vector< unsigned long long > _cv_offsets;
+    std::vector< unsigned long long > _example_offsets;
+    bool _map( const std::vector< std::vector< std::string > >& filenames, const std::vector< unsigned long long >& offsets, const std::vector< unsigned long long >& sizes );
+
+    std::vector< boost::shared_ptr< LLM_Index_Table_Region > > _regions;
+    const unsigned int * _values_data;
+    const unsigned long long * _cv_offsets_data;
+    const unsigned long long * _example_offsets_data;
+    unsigned int _num_rows;
+  };
+
+  /**
+   * the size in bytes of the shard files that an LLM_Index_Table_Writer cuts each array into
+   */
+  static const unsigned long long LLM_INDEX_TABLE_SHARD_SIZE = 64ull * 1024ull * 1024ull;
+
+  /**
+   * appends tables to the shard files prefix.values.N, prefix.cv_offsets.N and prefix.example_offsets.N, 
+   * rebasing their offsets, so that the index table of a corpus can be built without holding it in memory; 
+   * each array is cut into shards of shard_size() bytes, which LLM_Index_Table::map() joins back together
+   */
+  class LLM_Index_Table_Writer {
+  public:
+    LLM_Index_Table_Writer();
+    virtual ~LLM_Index_Table_Writer();
+
+    bool open( const std::string& prefix, const unsigned long long& shardSize = LLM_INDEX_TABLE_SHARD_SIZE );
+    bool append( const LLM_Index_Table& table );
+    bool close( void );
+
+    static std::string filename( const std::string& prefix, const unsigned int& array, const unsigned int& shard );
+
+    inline bool is_open( void )const{ return _files[ 0 ].is_open(); };
+    inline const std::string& prefix( void )const{ return _prefix; };
+    inline const unsigned long long& shard_size( void )const{ return _shard_size; };
+    inline unsigned int num_rows( void )const{ return _num_rows; };
+
+  protected:
+    bool _write( const unsigned int& array, const void* data, const unsigned long long& size );
+
+    std::string _prefix;
+    unsigned long long _shard_size;
+    std::ofstream _files[ 3 ];
+    unsigned int _shards[ 3 ];
+    unsigned long long _shard_bytes[ 3 ];
+    bool _failed;
+    unsigned long long _num_values;
+    unsigned long long _num_cvs;
+    unsigned int _num_rows;
+
+  private:
+    LLM_Index_Table_Writer( const LLM_Index_Table_Writer& other );
+    LLM_Index_Table_Writer& operator=( const LLM_Index_Table_Writer& other );
+  };
+
+  /**
+   * a dense gradient buffer that remembers which entries were written so that it can be merged 
+   * and cleared in time proportional to the number of touched entries
+   */
+  class LLM_Gradient_Buffer {
+  public:
+    LLM_Gradient_Buffer( const unsigned int& size = 0 );
+    virtual ~LLM_Gradient_Buffer();
+    LLM_Gradient_Buffer( const LLM_Gradient_Buffer& other );
+    LLM_Gradient_Buffer& operator=( const LLM_Gradient_Buffer& other );
+
+    void resize( const unsigned int& size );
+    void clear( void );
+    void merge( LLM_Gradient_Buffer& other );
+
+    inline void add( const unsigned int& index, const double& value ){ if( !_flags[ index ] ){ _flags[ index ] = true; _touched.push_back( index ); } _values[ index ] += value; };
+
+    inline const std::vector< double >& values( void )const{ return _values; };
+    inline const std::vector< unsigned int >& touched( void )const{ return _touched; };
+
+  protected:
+    std::vector< double > _values;
+    std::vector< unsigned int > _touched;
+    std::vector< bool > _flags;
+  };
+
   class LLM {
   public:
     LLM( Feature_Set* featureSet = NULL );
@@ -79,6 +304,9 @@ namespace h2sl {
     LLM& operator=( const LLM& other );
 
     double pygx( const unsigned int& cv, const LLM_X& x, const std::vector< unsigned int >& cvs, const std::vector< std::vector< unsigned int > >& indices );
+    double pygx( const unsigned int& cv, const std::vector< unsigned int >& cvs, const LLM_Index_Table& indices, const unsigned int& row );
+    void log_pygx( const LLM_Index_Table& indices, const unsigned int& begin, const unsigned int& end, std::vector< double >& logPygxs )const;
+    void log_pygx( const LLM_Index_Table& indices, const std::vector< unsigned int >& rows, const unsigned int& begin, const unsigned int& end, std::vector< double >& logPygxs )const;
     double pygx( const unsigned int& cv, const LLM_X& x, const std::vector< unsigned int >& cvs, std::vector< unsigned int >& indices );
     double pygx( const unsigned int& cv, const LLM_X& x, const std::vector< unsigned int >& cvs, std::vector< Feature* >& features );
 //    double pygx( const unsigned int& cv, const Grounding* grounding, const std::vector< Grounding* >& children, const Phrase* phrase, const World* world, const std::vector< unsigned int >& cvs );
@@ -86,12 +314,22 @@ namespace h2sl {
     double pygx( const unsigned int& cv, const Grounding* grounding, const std::vector< std::pair< const Phrase*, std::vector< Grounding* > > >& children, const Phrase* phrase, const World* world, const std::vector< unsigned int >& cvs );
     double pygx( const unsigned int& cv, const Grounding* grounding, const std::vector< std::pair< const Phrase*, std::vector< Grounding* > > >& children, const Phrase* phrase, const World* world, const std::vector< unsigned int >& cvs, const std::vector< bool >& evaluateFeatureTypes );
 
+    static double softmax( const unsigned int& cv, const std::vector< unsigned int >& cvs, const std::vector< double >& dps );
+
     virtual void to_xml( const std::string& filename )const;
     virtual void to_xml( xmlDocPtr doc, xmlNodePtr root )const;
 
     virtual void from_xml( const std::string& filename );
     virtual void from_xml( xmlNodePtr root );
 
+    virtual bool to_binary( const std::string& filename )const;
+    virtual bool from_binary( const std::string& filename );
+    static bool is_binary( const std::string& filename );
+
+    virtual bool from_file( const std::string& filename );
+
+    unsigned int prune( const double& threshold );
+
     inline std::vector< double >& weights( void ){ return _weights; };
     inline const std::vector< double >& weights( void )const{ return _weights; };
     inline Feature_Set*& feature_set( void ){ return _feature_set; };
@@ -106,51 +344,226 @@ namespace h2sl {
   };
   std::ostream& operator<<( std::ostream& out, const LLM& other );
 
+  /**
+   * the label of one row of the index table: the correspondence variable, a mask of the candidate 
+   * correspondence variables that are equal to it, the phrase it was scraped from and its weight
+   */
   class LLM_Index_Map_Cell {
   public:
-    LLM_Index_Map_Cell( const unsigned int& index, const unsigned int& cv, const LLM_X& llmX, std::vector< std::vector< unsigned int > >& indices ) : _index( index ), _cv( cv ), _llm_x( llmX ), _indices( indices ) {};
+    LLM_Index_Map_Cell( const unsigned int& index = 0, const unsigned int& cv = CV_UNKNOWN, const unsigned int& labels = 0, const unsigned int& group = 0, const double& weight = 1.0, const unsigned int& cvs = 0 ) : _index( index ), _cv( cv ), _labels( labels ), _group( group ), _cvs( cvs ), _weight( weight ) {};
     virtual ~LLM_Index_Map_Cell(){};
 
     inline const unsigned int& index( void )const{ return _index; };
     inline const unsigned int& cv( void )const{ return _cv; };
-    inline const LLM_X& llm_x( void )const{ return _llm_x; };
-    inline std::vector< std::vector< unsigned int > >& indices( void ){ return _indices; };
+    inline const unsigned int& labels( void )const{ return _labels; };
+    inline bool is_label( const unsigned int& k )const{ return ( ( _labels >> k ) & 1u ) != 0; };
+    inline const unsigned int& group( void )const{ return _group; };
+    inline const unsigned int& cvs( void )const{ return _cvs; };
+    inline double& weight( void ){ return _weight; };
+    inline const double& weight( void )const{ return _weight; };
 
   protected:
-    const unsigned int& _index;
-    const unsigned int& _cv;
-    const LLM_X& _llm_x;
-    std::vector< std::vector< unsigned int > >& _indices;
+    unsigned int _index;
+    unsigned int _cv;
+    unsigned int _labels;
+    unsigned int _group;
+    unsigned int _cvs;
+    double _weight;
+  };
+
+  class LLM_Index_Map_Shard {
+  public:
+    LLM_Index_Map_Shard( const std::vector< LLM_Index_Map_Cell >& cells, const unsigned int& begin, const unsigned int& end ) : _cells( &cells ), _begin( begin ), _end( end ) {};
+    virtual ~LLM_Index_Map_Shard(){};
+
+    inline unsigned int size( void )const{ return _end - _begin; };
+    inline const unsigned int& begin( void )const{ return _begin; };
+    inline const unsigned int& end( void )const{ return _end; };
+    inline const LLM_Index_Map_Cell& operator[]( const unsigned int& i )const{ return (*_cells)[ _begin + i ]; };
+
+  protected:
+    const std::vector< LLM_Index_Map_Cell > * _cells;
+    unsigned int _begin;
+    unsigned int _end;
+  };
+
+  typedef struct {
+    unsigned int iteration;
+    double objective;
+    double num_correct;
+  } llm_holdout_result_t;
+
+  /**
+   * weighted counts of an evaluation; confusion[ labeled cv ][ predicted cv ] and log_loss is the 
+   * sum of -log p( labeled cv | x ) over the examples
+   */
+  typedef struct {
+    double num_examples;
+    double num_correct;
+    double log_loss;
+    double confusion[ NUM_CVS ][ NUM_CVS ];
+  } llm_evaluation_t;
+
+  /**
+   * scores snapshots of the weights on held-out rows of the index table on a background thread and 
+   * remembers the snapshot with the highest held-out log-likelihood
+   */
+  class LLM_Holdout {
+  public:
+    LLM_Holdout( const LLM_Index_Table& indices, const std::vector< LLM_Index_Map_Cell >& cells, const std::vector< std::pair< unsigned int, unsigned int > >& ranges, const unsigned int& patience );
+    virtual ~LLM_Holdout();
+
+    void submit( const unsigned int& iteration, const double* weights, const unsigned int& size );
+    void finish( void );
+    bool plateaued( void );
+
+    inline const std::vector< llm_holdout_result_t >& results( void )const{ return _results; };
+    inline const std::vector< double >& best_weights( void )const{ return _best_weights; };
+    inline const unsigned int& best( void )const{ return _best; };
+
+  protected:
+    void _worker( void );
+    llm_holdout_result_t _evaluate( const unsigned int& iteration );
+
+    const LLM_Index_Table * _indices;
+    const std::vector< LLM_Index_Map_Cell > * _cells;
+    std::vector< std::pair< unsigned int, unsigned int > > _ranges;
+    unsigned int _patience;
+    LLM _llm;
+    std::deque< std::pair< unsigned int, std::vector< double > > > _pending;
+    std::vector< llm_holdout_result_t > _results;
+    std::vector< double > _best_weights;
+    unsigned int _best;
+    bool _busy;
+    bool _shutdown;
+    boost::mutex _mutex;
+    boost::condition_variable _pending_condition;
+    boost::condition_variable _idle_condition;
+    boost::thread * _thread;
+
+  private:
+    LLM_Holdout( const LLM_Holdout& other );
+    LLM_Holdout& operator=( const LLM_Holdout& other );
+
   };
 
   class LLM_Train {
   public:
-    LLM_Train( const std::vector< LLM* >& llms = std::vector< LLM* >(), std::vector< std::pair< unsigned int, LLM_X > >* examples = NULL );  
+    LLM_Train( const std::vector< LLM* >& llms = std::vector< LLM* >() );  
     ~LLM_Train();
     LLM_Train( const LLM_Train& other );
     LLM_Train& operator=( const LLM_Train& other );
  
-    void train( std::vector< std::pair< unsigned int, LLM_X > >& examples, const unsigned int& maxIterations = 100, const double& lambda = 0.01, const double& epsilon = 0.001 );
-    static void compute_objective_thread( std::vector< LLM_Index_Map_Cell >& cells, LLM* llm, double& objective );
-    double objective( const std::vector< std::pair< unsigned int, LLM_X > >& examples, const std::vector< std::vector< std::vector< unsigned int > > >& indices, double lambda );
-    static void compute_gradient_thread( std::vector< LLM_Index_Map_Cell >& cells, LLM* llm, std::vector< double >& gradient );
-    void gradient( double lambda ); 
-    static void compute_indices_thread( std::vector< LLM_Index_Map_Cell >& cells, LLM* llm );
-    void compute_indices( void );
+    bool train( const LLM_Example_Set& examples, const unsigned int& maxIterations = 100, const double& lambda = 0.001, const double& epsilon = 0.001 );
+    bool prepare( const LLM_Example_Set& examples );
+    bool clear_examples( void );
+    bool add_examples( const LLM_Example_Set& examples );
+    bool prepare( void );
+    void optimize( const unsigned int& maxIterations = 100, const double& lambda = 0.001, const double& epsilon = 0.001 );
+    double num_correct( const LLM* llm, const unsigned int& begin, const unsigned int& end )const;
+    void evaluate( const LLM* llm, const std::vector< std::pair< unsigned int, unsigned int > >& ranges, std::vector< llm_evaluation_t >& evaluations );
+    static void compute_evaluation_worker( const std::vector< std::pair< unsigned int, unsigned int > >& chunks, const std::vector< LLM_Index_Map_Cell >& cells, const LLM_Index_Table& indices, const std::vector< std::vector< unsigned int > >& cvSets, const std::vector< std::pair< unsigned int, unsigned int > >& ranges, const LLM* llm, Work_Queue& queue, std::vector< std::vector< std::pair< unsigned int, llm_evaluation_t > > >& evaluations );
+    static void compute_objective_and_gradient_thread( const LLM_Index_Map_Shard& shard, const LLM_Index_Table& indices, LLM* llm, double& objective, std::vector< double >& gradient, std::vector< double >& scores );
+    static void compute_objective_and_gradient_worker( const std::vector< LLM_Index_Map_Shard >& shards, const std::vector< std::vector< unsigned int > >& touched, const LLM_Index_Table& indices, LLM* llm, Work_Queue& queue, std::vector< double >& objectives, std::vector< double >& gradient, std::vector< double >& scores, std::vector< std::vector< double > >& shardGradients );
+    double objective_and_gradient( double lambda );
+    void serve( void );
+    static void compute_minibatch_thread( const std::vector< unsigned int >& rows, const unsigned int& begin, const unsigned int& end, const std::vector< LLM_Index_Map_Cell >& cells, const LLM_Index_Table& indices, const LLM* llm, double& objective, LLM_Gradient_Buffer& gradient, std::vector< double >& scores );
+    static void compute_indices_thread( const LLM_Example_Set& examples, const unsigned int& begin, const unsigned int& end, LLM_Index_Table& indices, LLM* llm );
+    static void compute_indices_worker( const LLM_Example_Set& examples, const std::vector< std::pair< unsigned int, unsigned int > >& chunks, std::vector< LLM_Index_Table >& indices, Work_Queue& queue, LLM* llm );
+    void partition( const unsigned int& numShards );
 
     inline std::vector< LLM* >& llms( void ){ return _llms; };
-    inline std::vector< std::pair< unsigned int, LLM_X > >*& examples( void ){ return _examples; };
-    inline std::vector< double > gradient( void ){ return _gradient; };
-    inline std::vector< std::vector< std::vector< unsigned int > > >& indices( void ){ return _indices; };
+    inline const unsigned int& num_examples( void )const{ return _num_examples; };
+    inline const std::vector< double >& gradient( void )const{ return _gradient; };
+    inline LLM_Index_Table& indices( void ){ return *_indices; };
+    inline const LLM_Index_Table& indices( void )const{ return *_indices; };
     inline std::vector< std::vector< std::vector< Feature* > > >& features( void ){ return _features; };
+    inline unsigned int& chunk_size( void ){ return _chunk_size; };
+    inline llm_train_optimizer_t& optimizer( void ){ return _optimizer; };
+    inline unsigned int& batch_size( void ){ return _batch_size; };
+    inline double& learning_rate( void ){ return _learning_rate; };
+    inline double& lambda( void ){ return _lambda; };
+    inline double& l1( void ){ return _l1; };
+    inline bool& verbose( void ){ return _verbose; };
+    inline bool& deduplicate( void ){ return _deduplicate; };
+    inline bool& deterministic( void ){ return _deterministic; };
+    inline unsigned int& negatives( void ){ return _negatives; };
+    inline bool& hard_negatives( void ){ return _hard_negatives; };
+    inline std::vector< std::pair< unsigned int, unsigned int > >& row_ranges( void ){ return _row_ranges; };
+    inline std::vector< std::pair< unsigned int, unsigned int > >& holdout_ranges( void ){ return _holdout_ranges; };
+    inline unsigned int& patience( void ){ return _patience; };
+    inline unsigned int& holdout_interval( void ){ return _holdout_interval; };
+    inline LLM_Holdout* holdout( void ){ return _holdout; };
+    inline const double& final_objective( void )const{ return _final_objective; };
+    inline Telemetry*& telemetry( void ){ return _telemetry; };
+    inline Process_Group*& process_group( void ){ return _process_group; };
+    inline const unsigned int& num_evaluations( void )const{ return _num_evaluations; };
+    inline unsigned int& seed( void ){ return _seed; };
+    inline std::vector< double >& prior( void ){ return _prior; };
+    inline double& prior_lambda( void ){ return _prior_lambda; };
+    inline std::string& index_cache( void ){ return _index_cache; };
+    inline std::string& index_cache_key( void ){ return _index_cache_key; };
+    inline std::string& out_of_core( void ){ return _out_of_core; };
+    inline const std::vector< std::pair< unsigned int, unsigned int > >& shards( void )const{ return _shards; };
+    inline const std::vector< std::vector< unsigned int > >& cv_sets( void )const{ return _cv_sets; };
 
   protected:
+    void _train_lbfgs( const unsigned int& maxIterations, const double& epsilon );
+    void _train_stochastic( const unsigned int& maxIterations, const double& lambda, const double& epsilon );
+    LLM_Index_Map_Shard _shard( const unsigned int& index )const;
+    std::vector< std::pair< unsigned int, unsigned int > > _training_ranges( void )const;
+    void _run_jobs( const std::vector< boost::function< void( void ) > >& jobs );
+    void _merge_shard_gradients( void );
+    double _data_objective_and_gradient( void );
+    void _restore_best_holdout_weights( void );
+    void _merge_duplicates( void );
+    void _subsample_negatives( void );
+
     std::vector< LLM* > _llms;
-    std::vector< std::pair< unsigned int, LLM_X > >* _examples; 
-    std::vector< std::vector< LLM_Index_Map_Cell > > _index_vector;
+    std::vector< LLM_Index_Map_Cell > _cells;
+    std::vector< std::vector< unsigned int > > _cv_sets;
+    unsigned int _num_examples;
+    unsigned int _num_groups;
+    bool _cached;
+    double _index_seconds;
+    std::vector< double > _index_busy;
+    std::vector< std::pair< unsigned int, unsigned int > > _shards;
     std::vector< double > _gradient;
-    std::vector< std::vector< std::vector< unsigned int > > > _indices;
+    std::vector< std::vector< double > > _shard_gradients;
+    std::vector< std::vector< double > > _thread_gradients;
+    std::vector< std::vector< double > > _thread_scores;
+    std::vector< std::vector< unsigned int > > _shard_touched;
+    boost::shared_ptr< LLM_Index_Table > _indices;
     std::vector< std::vector< std::vector< Feature* > > > _features;
+    unsigned int _chunk_size;
+    llm_train_optimizer_t _optimizer;
+    unsigned int _batch_size;
+    double _learning_rate;
+    double _lambda;
+    double _l1;
+    bool _verbose;
+    bool _deduplicate;
+    bool _deterministic;
+    unsigned int _negatives;
+    bool _hard_negatives;
+    std::vector< std::pair< unsigned int, unsigned int > > _row_ranges;
+    std::vector< std::pair< unsigned int, unsigned int > > _holdout_ranges;
+    unsigned int _patience;
+    unsigned int _holdout_interval;
+    LLM_Holdout * _holdout;
+    double _final_objective;
+    Telemetry * _telemetry;
+    Process_Group * _process_group;
+    unsigned int _num_evaluations;
+    std::vector< double > _job_seconds;
+    unsigned int _seed;
+    std::vector< double > _prior;
+    double _prior_lambda;
+    std::string _index_cache;
+    std::string _index_cache_key;
+    std::string _out_of_core;
+    boost::shared_ptr< LLM_Index_Table_Writer > _index_writer;
+    Thread_Pool * _thread_pool;
   };
 }
 
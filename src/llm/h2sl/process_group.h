@@ -0,0 +1,84 @@
+/**
+ * @file    process_group.h
+ * @author  Thomas M. Howard (tmhoward@csail.mit.edu)
+ *          Matthew R. Walter (mwalter@csail.mit.edu)
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This file is part of h2sl.
+ *
+ * Copyright (C) 2014 by the Massachusetts Institute of Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/gpl-2.0.html> or write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * @section DESCRIPTION
+ *
+ * The interface for a class used to connect a coordinator process to local worker processes
+ */
+
+#ifndef H2SL_PROCESS_GROUP_H
+#define H2SL_PROCESS_GROUP_H
+
+#include <iostream>
+#include <vector>
+#include <sys/types.h>
+
+namespace h2sl {
+  /**
+   * a coordinator and the worker processes it forked, connected by Unix-domain socket pairs; the 
+   * coordinator broadcasts the weights and sums the objective and (sparse) gradient of every worker, 
+   * then finishes the group with the trained weights and gathers what the workers report about them
+   */
+  class Process_Group {
+  public:
+    Process_Group();
+    virtual ~Process_Group();
+
+    unsigned int fork( const unsigned int& numWorkers );
+
+    void broadcast( const std::vector< double >& weights );
+    void reduce( double& objective, std::vector< double >& gradient );
+    void finish( const std::vector< double >& weights );
+    void gather( std::vector< std::vector< double > >& values );
+    void stop( void );
+
+    bool receive( std::vector< double >& weights );
+    void send( const double& objective, const std::vector< double >& gradient );
+    void send( const std::vector< double >& values );
+
+    inline const unsigned int& rank( void )const{ return _rank; };
+    inline const bool& finished( void )const{ return _finished; };
+    inline unsigned int size( void )const{ return _rank == 0 ? _sockets.size() + 1 : 0; };
+    inline bool is_coordinator( void )const{ return ( _rank == 0 ) && !_sockets.empty(); };
+
+  protected:
+    void _send_weights( const unsigned int& command, const std::vector< double >& weights );
+
+    unsigned int _rank;
+    bool _finished;
+    std::vector< int > _sockets;
+    std::vector< pid_t > _pids;
+
+  private:
+    Process_Group( const Process_Group& other );
+    Process_Group& operator=( const Process_Group& other );
+
+  };
+}
+
+#endif /* H2SL_PROCESS_GROUP_H */
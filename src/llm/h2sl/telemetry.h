@@ -0,0 +1,94 @@
+/**
+ * @file    telemetry.h
+ * @author  Thomas M. Howard (tmhoward@csail.mit.edu)
+ *          Matthew R. Walter (mwalter@csail.mit.edu)
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This file is part of h2sl.
+ *
+ * Copyright (C) 2014 by the Massachusetts Institute of Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/gpl-2.0.html> or write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * @section DESCRIPTION
+ *
+ * The interface for a class used to record training telemetry as JSON lines
+ */
+
+#ifndef H2SL_TELEMETRY_H
+#define H2SL_TELEMETRY_H
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <sys/time.h>
+#include <boost/thread.hpp>
+
+namespace h2sl {
+  /**
+   * a single JSON object written as one line of the telemetry file
+   */
+  class Telemetry_Record {
+  public:
+    Telemetry_Record( const std::string& event = "" );
+    virtual ~Telemetry_Record();
+    Telemetry_Record( const Telemetry_Record& other );
+    Telemetry_Record& operator=( const Telemetry_Record& other );
+
+    Telemetry_Record& add( const std::string& name, const double& value );
+    Telemetry_Record& add( const std::string& name, const std::string& value );
+    Telemetry_Record& add( const std::string& name, const std::vector< double >& values );
+
+    std::string str( void )const;
+
+  protected:
+    std::string _fields;
+  };
+
+  /**
+   * a thread-safe sink of telemetry records, each stamped with the event name and the seconds since open()
+   */
+  class Telemetry {
+  public:
+    Telemetry();
+    virtual ~Telemetry();
+
+    bool open( const std::string& filename );
+    void close( void );
+    void write( const std::string& event, const Telemetry_Record& record );
+
+    double elapsed( void )const;
+    static double max_rss( void );
+
+    inline bool is_open( void )const{ return _out.is_open(); };
+
+  protected:
+    std::ofstream _out;
+    boost::mutex _mutex;
+    struct timeval _start_time;
+
+  private:
+    Telemetry( const Telemetry& other );
+    Telemetry& operator=( const Telemetry& other );
+
+  };
+}
+
+#endif /* H2SL_TELEMETRY_H */
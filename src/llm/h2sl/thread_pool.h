@@ -0,0 +1,84 @@
+/**
+ * @file    thread_pool.h
+ * @author  Thomas M. Howard (tmhoward@csail.mit.edu)
+ *          Matthew R. Walter (mwalter@csail.mit.edu)
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This file is part of h2sl.
+ *
+ * Copyright (C) 2014 by the Massachusetts Institute of Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/gpl-2.0.html> or write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * @section DESCRIPTION
+ *
+ * The interface for a class used to represent a persistent pool of worker threads
+ */
+
+#ifndef H2SL_THREAD_POOL_H
+#define H2SL_THREAD_POOL_H
+
+#include <iostream>
+#include <vector>
+#include <boost/thread.hpp>
+#include <boost/function.hpp>
+
+namespace h2sl {
+  class Work_Queue {
+  public:
+    Work_Queue( const unsigned int& size = 0 ) : _mutex(), _next( 0 ), _size( size ) {};
+    virtual ~Work_Queue(){};
+
+    inline bool next( unsigned int& index ){ boost::mutex::scoped_lock lock( _mutex ); if( _next < _size ){ index = _next++; return true; } return false; };
+
+  protected:
+    boost::mutex _mutex;
+    unsigned int _next;
+    unsigned int _size;
+  };
+
+  class Thread_Pool {
+  public:
+    Thread_Pool( const unsigned int& numThreads = 1 );
+    virtual ~Thread_Pool();
+
+    void run( const std::vector< boost::function< void( void ) > >& jobs );
+
+    inline unsigned int size( void )const{ return _threads.size(); };
+
+  protected:
+    void _worker( const unsigned int& index );
+
+    std::vector< boost::thread* > _threads;
+    std::vector< boost::function< void( void ) > > _jobs;
+    boost::mutex _mutex;
+    boost::condition_variable _job_condition;
+    boost::condition_variable _done_condition;
+    unsigned int _generation;
+    unsigned int _num_pending;
+    bool _shutdown;
+
+  private:
+    Thread_Pool( const Thread_Pool& other );
+    Thread_Pool& operator=( const Thread_Pool& other );
+
+  };
+}
+
+#endif /* H2SL_THREAD_POOL_H */
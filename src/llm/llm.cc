@@ -33,19 +33,48 @@
 
 #include <iomanip>
 #include <sstream>
+#include <fstream>
 #include <cmath>
+#include <cstring>
+#include <limits>
 #include <map>
+#include <algorithm>
 #include <boost/algorithm/string.hpp>
-#include <boost/thread.hpp>
+#include <boost/bind/bind.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/crc.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+#include <boost/random/uniform_real_distribution.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
 #include <lbfgs.h>
 
+#include "h2sl/common.h"
+#include "h2sl/grounding_set.h"
 #include "h2sl/region.h"
 #include "h2sl/constraint.h"
+#include "h2sl/object.h"
+#include "h2sl/spatial_function.h"
 #include <h2sl/llm.h>
 
 using namespace std;
 using namespace h2sl;
 
+/**
+ * the number of rows in a shard and the number of pieces a minibatch is split into when the 
+ * reductions have to be independent of the number of threads
+ */
+static const unsigned int LLM_TRAIN_DETERMINISTIC_SHARD_ROWS = 1024;
+static const unsigned int LLM_TRAIN_DETERMINISTIC_PIECES = 8;
+
 lbfgsfloatval_t
 evaluate( void * instance,
           const lbfgsfloatval_t * x,
@@ -61,9 +90,7 @@ evaluate( void * instance,
     }
   }  
 
-  lbfgsfloatval_t objective = ( lbfgsfloatval_t )( llm_train->objective( *llm_train->examples(), llm_train->indices(), 0.001 ) );
-
-  llm_train->gradient( 0.001 );
+  lbfgsfloatval_t objective = ( lbfgsfloatval_t )( llm_train->objective_and_gradient( llm_train->lambda() ) );
 
   for( unsigned int i = 0; i < llm_train->gradient().size(); i++ ){
     g[ i ] = -llm_train->gradient()[ i ];
@@ -83,10 +110,164 @@ progress( void * instance,
           int n,
           int k,
           int ls ) {
-  cout << setw(3) << setfill(' ') << k << " " << setw(8) << setfill(' ') <<  -fx << " (" << xnorm << ") (" << gnorm << ")" << endl;
+  LLM_Train* llm_train = static_cast< LLM_Train* >( instance );
+  if( llm_train->telemetry() != NULL ){
+    llm_train->telemetry()->write( "iteration", Telemetry_Record().add( "iteration", k ).add( "objective", -fx ).add( "xnorm", xnorm ).add( "gnorm", gnorm ).add( "step", step ).add( "line_search_evaluations", ls ).add( "evaluations", llm_train->num_evaluations() ).add( "max_rss_mb", Telemetry::max_rss() ) );
+  }
+  if( llm_train->verbose() ){
+    cout << setw(3) << setfill(' ') << k << " " << setw(8) << setfill(' ') <<  -fx << " (" << xnorm << ") (" << gnorm << ")" << endl;
+  }
+  // a nonzero return value cancels the optimization once the held-out log-likelihood stops improving
+  if( llm_train->holdout() != NULL ){
+    if( ( k % llm_train->holdout_interval() ) == 0 ){
+      llm_train->holdout()->submit( k, x, n );
+    }
+    if( llm_train->holdout()->plateaued() ){
+      return 1;
+    }
+  }
   return 0;
 }
 
+/**
+ * runs a job and stores its wall time, used to measure how busy each worker was
+ */
+void
+run_timed_job( const boost::function< void( void ) >& job,
+                double& seconds ){
+  struct timeval start_time;
+  gettimeofday( &start_time, NULL );
+  job();
+  struct timeval end_time;
+  gettimeofday( &end_time, NULL );
+  seconds = diff_time( start_time, end_time );
+  return;
+}
+
+inline void
+add_gradient( vector< double >& gradient,
+              const unsigned int& index,
+              const double& value ){
+  gradient[ index ] += value;
+  return;
+}
+
+inline void
+add_gradient( LLM_Gradient_Buffer& gradient,
+              const unsigned int& index,
+              const double& value ){
+  gradient.add( index, value );
+  return;
+}
+
+/**
+ * moves value towards zero by threshold, stopping at zero
+ */
+inline double
+soft_threshold( const double& value,
+                const double& threshold ){
+  if( value > threshold ){
+    return value - threshold;
+  } else if( value < -threshold ){
+    return value + threshold;
+  } else {
+    return 0.0;
+  }
+}
+
+/**
+ * sums the weights of the indices [first,last) into four accumulators so that the loads can overlap
+ */
+inline double
+dot_product( const double* weights,
+              const unsigned int* first,
+              const unsigned int* last ){
+  const unsigned int * index = first;
+  double dp0 = 0.0;
+  double dp1 = 0.0;
+  double dp2 = 0.0;
+  double dp3 = 0.0;
+  for( ; index + 4 <= last; index += 4 ){
+    dp0 += weights[ index[ 0 ] ];
+    dp1 += weights[ index[ 1 ] ];
+    dp2 += weights[ index[ 2 ] ];
+    dp3 += weights[ index[ 3 ] ];
+  }
+  for( ; index != last; index++ ){
+    dp0 += weights[ *index ];
+  }
+  return ( dp0 + dp1 ) + ( dp2 + dp3 );
+}
+
+/**
+ * turns the dot products of the correspondence variables of a row into log-probabilities with a log-sum-exp
+ */
+inline void
+log_normalize( double* scores,
+                const unsigned int& numCvs ){
+  if( numCvs == 0 ){
+    return;
+  }
+  double max_score = scores[ 0 ];
+  for( unsigned int j = 1; j < numCvs; j++ ){
+    max_score = max( max_score, scores[ j ] );
+  }
+  double sum = 0.0;
+  for( unsigned int j = 0; j < numCvs; j++ ){
+    sum += exp( scores[ j ] - max_score );
+  }
+  const double log_z = max_score + log( sum );
+  for( unsigned int j = 0; j < numCvs; j++ ){
+    scores[ j ] -= log_z;
+  }
+  return;
+}
+
+/**
+ * per-thread scratch space of pygx() on a row of an index table, so that callers on different threads neither allocate nor share it
+ */
+static boost::thread_specific_ptr< vector< double > > pygx_scratch;
+
+/**
+ * adds the weighted log-likelihood of one example and its gradient given the log-probabilities of its correspondence variables
+ */
+template< class T >
+inline void
+accumulate_example( const LLM_Index_Map_Cell& cell,
+                    const LLM_Index_Table& indices,
+                    const unsigned int& row,
+                    const double* logPygx,
+                    double& objective,
+                    T& gradient ){
+  const unsigned int num_cvs = indices.num_cvs( row );
+  double max_log_numerator = -numeric_limits< double >::infinity();
+  for( unsigned int k = 0; k < num_cvs; k++ ){
+    if( cell.is_label( k ) ){
+      max_log_numerator = max( max_log_numerator, logPygx[ k ] );
+    }
+  }
+  double numerator = 0.0;
+  for( unsigned int k = 0; k < num_cvs; k++ ){
+    if( cell.is_label( k ) ){
+      numerator += exp( logPygx[ k ] - max_log_numerator );
+    }
+  }
+  const double log_numerator = max_log_numerator + log( numerator );
+
+  for( unsigned int k = 0; k < num_cvs; k++ ){
+    double tmp = -exp( logPygx[ k ] );
+    if( cell.is_label( k ) ){
+      objective += cell.weight() * log_numerator;
+      tmp += 1.0;
+    }
+    tmp *= cell.weight();
+    for( const unsigned int* index = indices.begin( row, k ); index != indices.end( row, k ); index++ ){
+      add_gradient( gradient, *index, tmp );
+    }
+  }
+  return;
+}
+
 LLM_X::
 LLM_X( const Grounding* grounding,
         const Phrase* phrase,
@@ -125,6 +306,11 @@ LLM_X( const LLM_X& other ) : _grounding( other._grounding ),
 LLM_X&
 LLM_X::
 operator=( const LLM_X& other ) {
+  _grounding = other._grounding;
+  _phrase = other._phrase;
+  _world = other._world;
+  _cvs = other._cvs;
+  _filename = other._filename;
   _children.resize( other._children.size() );
   for( unsigned int i = 0; i < other._children.size(); i++ ){
     if( other._children[ i ].first != NULL ){
@@ -135,228 +321,1614 @@ operator=( const LLM_X& other ) {
   return *this;
 }
 
-namespace h2sl {
-  ostream&
-  operator<<( ostream& out,
-              const LLM_X& other ) {
-    out << "filename:\"" << other.filename() << "\"" << endl;
-    if( dynamic_cast< const Region* >( other.grounding() ) != NULL ){
-      out << "grounding:(" << *static_cast< const Region* >( other.grounding() ) << ") ";
-    }
-    if( other.phrase() != NULL ){
-      out << "phrase:(" << *other.phrase() << ")";
-    } else {
-      out << "phrase:(NULL)";
-    }
-    return out;
-  }
+LLM_Example_Set::
+LLM_Example_Set() : _examples(),
+                    _children(),
+                    _child_groundings(),
+                    _worlds(),
+                    _filenames(),
+                    _phrases(),
+                    _groundings(),
+                    _cv_sets(),
+                    _world_ids(),
+                    _phrase_ids(),
+                    _grounding_ids(),
+                    _cvs_ids() {
+
 }
 
-LLM::
-LLM( Feature_Set* featureSet ) : _weights(),
-                                  _feature_set( featureSet ){
+LLM_Example_Set::
+~LLM_Example_Set() {
 
 }
 
-LLM::
-~LLM() {
+LLM_Example_Set::
+LLM_Example_Set( const LLM_Example_Set& other ) : _examples( other._examples ),
+                                                  _children( other._children ),
+                                                  _child_groundings( other._child_groundings ),
+                                                  _worlds( other._worlds ),
+                                                  _filenames( other._filenames ),
+                                                  _phrases( other._phrases ),
+                                                  _groundings( other._groundings ),
+                                                  _cv_sets( other._cv_sets ),
+                                                  _world_ids( other._world_ids ),
+                                                  _phrase_ids( other._phrase_ids ),
+                                                  _grounding_ids( other._grounding_ids ),
+                                                  _cvs_ids( other._cvs_ids ) {
 
 }
 
-LLM::
-LLM( const LLM& other ) : _weights( other._weights ),
-                          _feature_set( other._feature_set ){
+LLM_Example_Set&
+LLM_Example_Set::
+operator=( const LLM_Example_Set& other ) {
+  _examples = other._examples;
+  _children = other._children;
+  _child_groundings = other._child_groundings;
+  _worlds = other._worlds;
+  _filenames = other._filenames;
+  _phrases = other._phrases;
+  _groundings = other._groundings;
+  _cv_sets = other._cv_sets;
+  _world_ids = other._world_ids;
+  _phrase_ids = other._phrase_ids;
+  _grounding_ids = other._grounding_ids;
+  _cvs_ids = other._cvs_ids;
+  return *this;
+}
 
+void
+LLM_Example_Set::
+clear( void ){
+  _examples.clear();
+  _children.clear();
+  _child_groundings.clear();
+  _worlds.clear();
+  _filenames.clear();
+  _phrases.clear();
+  _groundings.clear();
+  _cv_sets.clear();
+  _world_ids.clear();
+  _phrase_ids.clear();
+  _grounding_ids.clear();
+  _cvs_ids.clear();
+  return;
 }
 
-LLM&
-LLM::
-operator=( const LLM& other ) {
-  _weights = other._weights;
-  _feature_set = other._feature_set;
-  return (*this);
+unsigned int
+LLM_Example_Set::
+world_id( const World* world,
+          const string& filename ){
+  map< const World*, unsigned int >::iterator it = _world_ids.find( world );
+  if( it != _world_ids.end() ){
+    return it->second;
+  }
+  _world_ids.insert( pair< const World*, unsigned int >( world, _worlds.size() ) );
+  _worlds.push_back( world );
+  _filenames.push_back( filename );
+  return _worlds.size() - 1;
 }
 
-double
-LLM::
-pygx( const unsigned int& cv,
-      const LLM_X& x,
-      const vector< unsigned int >& cvs,
-      const vector< vector< unsigned int > >& indices ){
-  double numerator = 0.0;
-  double denominator = 0.0;
-  if( cvs.size() == indices.size() ){
-    for( unsigned int i = 0; i < cvs.size(); i++ ){
-    double dp = 0.0;
-      for( unsigned int j = 0; j < indices[ i ].size(); j++ ){
-        dp += _weights[ indices[ i ][ j ] ];
-      }
-      dp = exp( dp );
-      if( cv == cvs[ i ] ){
-        numerator += dp;
-      }
-      denominator += dp;
-    }
+unsigned int
+LLM_Example_Set::
+phrase_id( const Phrase* phrase ){
+  map< const Phrase*, unsigned int >::iterator it = _phrase_ids.find( phrase );
+  if( it != _phrase_ids.end() ){
+    return it->second;
   }
-  return ( numerator / denominator );
+  _phrase_ids.insert( pair< const Phrase*, unsigned int >( phrase, _phrases.size() ) );
+  _phrases.push_back( phrase );
+  return _phrases.size() - 1;
 }
 
-double
-LLM::
-pygx( const unsigned int& cv,
-      const LLM_X& x,
-      const vector< unsigned int >& cvs,
-      vector< unsigned int >& indices ){
-  double numerator = 0.0;
-  double denominator = 0.0;
-  vector< unsigned int > tmp;
-  vector< Feature* > tmp_features;
-  vector< bool > evaluate_feature_types( NUM_FEATURE_TYPES, true );
-  for( unsigned int i = 0; i < cvs.size(); i++ ){
-    if( i != 0 ){
-      evaluate_feature_types[ FEATURE_TYPE_LANGUAGE ] = false;
-      evaluate_feature_types[ FEATURE_TYPE_GROUNDING ] = false;
-    }
-    double dp = 0.0;
-    _feature_set->indices( cvs[ i ], x.grounding(), x.children(), x.phrase(), x.world(), tmp, tmp_features, evaluate_feature_types );
-    for( unsigned int j = 0; j < tmp.size(); j++ ){
-      dp += _weights[ tmp[ j ] ];
-    }
-    dp = exp( dp );
-    if( cv == cvs[ i ] ){
-      numerator += dp;
-      indices = tmp;
-    }
-    denominator += dp;
+unsigned int
+LLM_Example_Set::
+grounding_id( Grounding* grounding ){
+  map< const Grounding*, unsigned int >::iterator it = _grounding_ids.find( grounding );
+  if( it != _grounding_ids.end() ){
+    return it->second;
   }
-  return ( numerator / denominator );
+  _grounding_ids.insert( pair< const Grounding*, unsigned int >( grounding, _groundings.size() ) );
+  _groundings.push_back( grounding );
+  return _groundings.size() - 1;
 }
 
-double
-LLM::
-pygx( const unsigned int& cv,
-      const LLM_X& x,
-      const vector< unsigned int >& cvs,
-      vector< Feature* >& features ){
-  double numerator = 0.0;
-  double denominator = 0.0;
-  vector< unsigned int > indices;
-  vector< bool > evaluate_feature_types( NUM_FEATURE_TYPES, true );
-  for( unsigned int i = 0; i < cvs.size(); i++ ){
-    if( i != 0 ){
-      evaluate_feature_types[ FEATURE_TYPE_LANGUAGE ] = false;
-      evaluate_feature_types[ FEATURE_TYPE_GROUNDING ] = false; 
-    }
-    double dp = 0.0;
-    _feature_set->indices( cvs[ i ], x.grounding(), x.children(), x.phrase(), x.world(), indices, features, evaluate_feature_types );
-    for( unsigned int j = 0; j < indices.size(); j++ ){
-      dp += _weights[ indices[ j ] ];
-    }
-    dp = exp( dp );
-    if( cv == cvs[ i ] ){
-      numerator += dp;
-    }
-    denominator += dp;
+unsigned int
+LLM_Example_Set::
+cvs_id( const vector< unsigned int >& cvs ){
+  map< vector< unsigned int >, unsigned int >::iterator it = _cvs_ids.find( cvs );
+  if( it != _cvs_ids.end() ){
+    return it->second;
   }
-  return ( numerator / denominator );
+  _cvs_ids.insert( pair< vector< unsigned int >, unsigned int >( cvs, _cv_sets.size() ) );
+  _cv_sets.push_back( cvs );
+  return _cv_sets.size() - 1;
 }
 
-double
-LLM::
-pygx( const unsigned int& cv,
-      const Grounding* grounding,
-      const vector< pair< const Phrase*, vector< Grounding* > > >& children,
-      const Phrase* phrase,
-      const World* world,
-      const vector< unsigned int >& cvs ){
-  double numerator = 0.0;
-  double denominator = 0.0;
-  vector< unsigned int > indices;
-  vector< Feature* > features;
-  vector< bool > evaluate_feature_types( NUM_FEATURE_TYPES, true );
-  for( unsigned int i = 0; i < cvs.size(); i++ ){
-    if( i != 0 ){
-      evaluate_feature_types[ FEATURE_TYPE_LANGUAGE ] = false;
-      evaluate_feature_types[ FEATURE_TYPE_GROUNDING ] = false;
-    }
-    double dp = 0.0;
-    _feature_set->indices( cvs[ i ], grounding, children, phrase, world, indices, features, evaluate_feature_types );
-    for( unsigned int j = 0; j < indices.size(); j++ ){
-      dp += _weights[ indices[ j ] ];
+/**
+ * appends the child phrases and their groundings to the child table and returns the offset of the first
+ */
+unsigned int
+LLM_Example_Set::
+add_children( const vector< pair< const Phrase*, vector< Grounding* > > >& children ){
+  unsigned int offset = _children.size();
+  for( unsigned int i = 0; i < children.size(); i++ ){
+    llm_example_child_t child;
+    child.phrase = phrase_id( children[ i ].first );
+    child.groundings = _child_groundings.size();
+    child.num_groundings = children[ i ].second.size();
+    for( unsigned int j = 0; j < children[ i ].second.size(); j++ ){
+      _child_groundings.push_back( grounding_id( children[ i ].second[ j ] ) );
     }
-    dp = exp( dp );
-    if( cv == cvs[ i ] ){
-      numerator += dp;
+    _children.push_back( child );
+  }
+  return offset;
+}
+
+/**
+ * rebuilds the children of an example in the form the feature set expects
+ */
+void
+LLM_Example_Set::
+children( const llm_example_t& example,
+          vector< pair< const Phrase*, vector< Grounding* > > >& children )const{
+  children.resize( example.num_children );
+  for( unsigned int i = 0; i < example.num_children; i++ ){
+    const llm_example_child_t& child = _children[ example.children + i ];
+    children[ i ].first = _phrases[ child.phrase ];
+    children[ i ].second.resize( child.num_groundings );
+    for( unsigned int j = 0; j < child.num_groundings; j++ ){
+      children[ i ].second[ j ] = _groundings[ _child_groundings[ child.groundings + j ] ];
     }
-    denominator += dp;
   }
-  return ( numerator / denominator );
+  return;
 }
 
-double
-LLM::
-pygx( const unsigned int& cv,
-      const Grounding* grounding,
-      const vector< pair< const Phrase*, vector< Grounding* > > >& children,
-      const Phrase* phrase,
-      const World* world,
-      const vector< unsigned int >& cvs,
-      const vector< bool >& evaluateFeatureTypes ){
-  double numerator = 0.0;
-  double denominator = 0.0;
-  vector< unsigned int > indices;
-  vector< Feature* > features;
-  vector< bool > evaluate_feature_types = evaluateFeatureTypes;
-  for( unsigned int i = 0; i < cvs.size(); i++ ){
-    if( i != 0 ){
-      evaluate_feature_types[ FEATURE_TYPE_LANGUAGE ] = false;
-      evaluate_feature_types[ FEATURE_TYPE_GROUNDING ] = false;
+/**
+ * labels a grounding CV_TRUE if the grounding set of its phrase contains an equal grounding and 
+ * CV_FALSE otherwise; groundings of other types are CV_UNKNOWN
+ */
+static unsigned int
+evaluate_cv( const Grounding* grounding,
+              const Grounding_Set* groundingSet ){
+  unsigned int cv = CV_UNKNOWN;
+  if( dynamic_cast< const Region* >( grounding ) != NULL ){
+    const Region * region_grounding = dynamic_cast< const Region* >( grounding );
+    cv = CV_FALSE;
+    for( unsigned int i = 0; i < groundingSet->groundings().size(); i++ ){
+      if( dynamic_cast< const Region* >( groundingSet->groundings()[ i ] ) ){
+        if( *region_grounding == *dynamic_cast< const Region* >( groundingSet->groundings()[ i ] ) ){
+          cv = CV_TRUE;
+        }
+      }
     }
-    double dp = 0.0;
-    _feature_set->indices( cvs[ i ], grounding, children, phrase, world, indices, features, evaluate_feature_types );
-    for( unsigned int j = 0; j < indices.size(); j++ ){
-      dp += _weights[ indices[ j ] ];
+  } else if ( dynamic_cast< const Constraint* >( grounding ) != NULL ){
+    const Constraint* constraint_grounding = dynamic_cast< const Constraint* >( grounding );
+    cv = CV_FALSE;
+    for( unsigned int i = 0; i < groundingSet->groundings().size(); i++ ){
+      if( dynamic_cast< const Constraint* >( groundingSet->groundings()[ i ] ) ){
+        if( *constraint_grounding == *dynamic_cast< const Constraint* >( groundingSet->groundings()[ i ] ) ){
+          cv = CV_TRUE;
+        }
+      }
     }
-    dp = exp( dp );
-    if( cv == cvs[ i ] ){
-      numerator += dp;
+  } else if ( dynamic_cast< const Object* >( grounding ) != NULL ) {
+    const h2sl::Object* object_grounding = dynamic_cast< const h2sl::Object* >( grounding );
+    cv = CV_FALSE;
+    for( unsigned int i = 0; i < groundingSet->groundings().size(); i++ ){
+      if( dynamic_cast< const h2sl::Object* >( groundingSet->groundings()[ i ] ) ){
+        if( *object_grounding == *dynamic_cast< const h2sl::Object* >( groundingSet->groundings()[ i ] ) ){
+          cv = CV_TRUE;
+        }
+      }
     }
-    denominator += dp;
-  }
-  return ( numerator / denominator );
+  } else if ( dynamic_cast< const Spatial_Function* >( grounding ) != NULL ){
+    const Spatial_Function* spatial_function_grounding = dynamic_cast< const Spatial_Function* >( grounding );
+    cv = CV_FALSE;
+    for( unsigned int i = 0; i < groundingSet->groundings().size(); i++ ){
+      if( dynamic_cast< const Spatial_Function* >( groundingSet->groundings()[ i ] ) ){
+        const Spatial_Function* other_spatial_function_grounding = dynamic_cast< const Spatial_Function* >( groundingSet->groundings()[ i ] );
+        if( *spatial_function_grounding == *other_spatial_function_grounding ){
+          cv = CV_TRUE;
+        }  
+      }
+    }
+  }     
+ 
+  return cv;
 }
 
+/**
+ * appends one example per grounding of the search spaces for a phrase and, recursively, for each 
+ * of its children, labeling each against the groundings annotated on the phrase
+ */
 void
-LLM_Train::
-train( vector< pair< unsigned int, LLM_X > >& examples,
-        const unsigned int& maxIterations,
-        const double& lambda,
-        const double& epsilon ){
-
-  _examples = &examples;
-
-  if( _llms.front()->feature_set()->size() != _llms.front()->weights().size() ){
-    _llms.front()->weights().resize( _llms.front()->feature_set()->size(), 0.0 );
+LLM_Example_Set::
+scrape( const string& filename,
+        const Phrase* phrase,
+        const World* world,
+        const vector< pair< unsigned int, Grounding* > >& searchSpaces,
+        const vector< vector< unsigned int > >& correspondenceVariables ){
+  const Grounding_Set * grounding_set = dynamic_cast< const Grounding_Set* >( phrase->grounding() );
+
+  // every example of the phrase points at the same block of the child table
+  vector< pair< const Phrase*, vector< Grounding* > > > children;
+  for( unsigned int j = 0; j < phrase->children().size(); j++ ){
+    children.push_back( pair< const Phrase*, vector< Grounding* > >( phrase->children()[ j ], vector< Grounding* >() ) );
+    Grounding_Set * child_grounding_set = dynamic_cast< Grounding_Set* >( phrase->children()[ j ]->grounding() );
+    if( child_grounding_set ){
+      for( unsigned int k = 0; k < child_grounding_set->groundings().size(); k++ ){
+        children.back().second.push_back( child_grounding_set->groundings()[ k ] );
+      }   
+    }
   }
-  
-  lbfgsfloatval_t fx;
-  lbfgsfloatval_t * x = lbfgs_malloc( _llms.front()->feature_set()->size() );
 
-  for( unsigned int i = 0; i < _llms.front()->weights().size(); i++ ){
-    x[ i ] = _llms.front()->weights()[ i ];
+  llm_example_t example;
+  example.world = world_id( world, filename );
+  example.phrase = phrase_id( phrase );
+  example.children = add_children( children );
+  example.num_children = children.size();
+  for( unsigned int i = 0; i < searchSpaces.size(); i++ ){
+    example.cv = evaluate_cv( searchSpaces[ i ].second, grounding_set );
+    example.grounding = grounding_id( searchSpaces[ i ].second );
+    example.cvs = cvs_id( correspondenceVariables[ searchSpaces[ i ].first ] );
+    push_back( example );
   }
 
-  lbfgs_parameter_t param;
-  lbfgs_parameter_init(&param);
-  param.epsilon = epsilon;
-  param.max_iterations = maxIterations;
-
-  compute_indices();
-
-  lbfgs( _llms.front()->weights().size(), x, &fx, evaluate, progress, ( void* )( this ), &param );
-
-  for( unsigned int i = 0; i < _llms.front()->weights().size(); i++ ){
-    _llms.front()->weights()[ i ] = x[ i ];
+  for( unsigned int i = 0; i < phrase->children().size(); i++ ){
+    scrape( filename, phrase->children()[ i ], world, searchSpaces, correspondenceVariables );
+  }
+  return;
+}
+
+namespace h2sl {
+  ostream&
+  operator<<( ostream& out,
+              const LLM_X& other ) {
+    out << "filename:\"" << other.filename() << "\"" << endl;
+    if( dynamic_cast< const Region* >( other.grounding() ) != NULL ){
+      out << "grounding:(" << *static_cast< const Region* >( other.grounding() ) << ") ";
+    }
+    if( other.phrase() != NULL ){
+      out << "phrase:(" << *other.phrase() << ")";
+    } else {
+      out << "phrase:(NULL)";
+    }
+    return out;
+  }
+}
+
+LLM_Index_Table_Region::
+LLM_Index_Table_Region() : _address( NULL ),
+                            _length( 0 ),
+                            _data( NULL ),
+                            _size( 0 ) {
+
+}
+
+LLM_Index_Table_Region::
+~LLM_Index_Table_Region() {
+  unmap();
+}
+
+/**
+ * reserves a range of addresses for the bytes [offset,offset+size) of the concatenated files and maps 
+ * the pages of each file that overlap them into it, returning false if a file is missing, short or 
+ * not a multiple of the page size; an empty range maps nothing
+ */
+bool
+LLM_Index_Table_Region::
+map( const vector< string >& filenames,
+      const unsigned long long& offset,
+      const unsigned long long& size ){
+  unmap();
+  if( size == 0 ){
+    return true;
+  }
+
+  const unsigned long long page_size = boost::interprocess::mapped_region::get_page_size();
+  const unsigned long long first = ( offset / page_size ) * page_size;
+  _length = offset + size - first;
+  _address = mmap( NULL, _length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+  if( _address == MAP_FAILED ){
+    _address = NULL;
+    _length = 0;
+    return false;
+  }
+
+  // each file starts on a page boundary of the concatenation, so its pages land next to those of the previous one
+  unsigned long long position = 0;
+  for( unsigned int i = 0; ( i < filenames.size() ) && ( position < offset + size ); i++ ){
+    int file = ::open( filenames[ i ].c_str(), O_RDONLY );
+    struct stat file_stat;
+    if( ( file < 0 ) || ( fstat( file, &file_stat ) != 0 ) ){
+      if( file >= 0 ){
+        ::close( file );
+      }
+      unmap();
+      return false;
+    }
+    const unsigned long long file_size = file_stat.st_size;
+    const unsigned long long begin = max( first, position );
+    const unsigned long long end = min( offset + size, position + file_size );
+    bool success = ( i + 1 == filenames.size() ) || ( file_size % page_size == 0 );
+    if( success && ( begin < end ) ){
+      success = ( mmap( ( char* )( _address ) + ( begin - first ), end - begin, PROT_READ, MAP_SHARED | MAP_FIXED, file, begin - position ) != MAP_FAILED );
+    }
+    ::close( file );
+    if( !success ){
+      unmap();
+      return false;
+    }
+    position += file_size;
+  }
+  if( position < offset + size ){
+    unmap();
+    return false;
+  }
+
+  posix_madvise( _address, _length, POSIX_MADV_SEQUENTIAL );
+  _data = ( const char* )( _address ) + ( offset - first );
+  _size = size;
+  return true;
+}
+
+void
+LLM_Index_Table_Region::
+unmap( void ){
+  if( _address != NULL ){
+    munmap( _address, _length );
+  }
+  _address = NULL;
+  _length = 0;
+  _data = NULL;
+  _size = 0;
+  return;
+}
+
+LLM_Index_Table::
+LLM_Index_Table() : _values(),
+                    _cv_offsets( 1, 0 ),
+                    _example_offsets( 1, 0 ),
+                    _regions(),
+                    _values_data( NULL ),
+                    _cv_offsets_data( NULL ),
+                    _example_offsets_data( NULL ),
+                    _num_rows( 0 ) {
+  _sync();
+}
+
+LLM_Index_Table::
+~LLM_Index_Table() {
+
+}
+
+LLM_Index_Table::
+LLM_Index_Table( const LLM_Index_Table& other ) : _values( other._values ),
+                                                  _cv_offsets( other._cv_offsets ),
+                                                  _example_offsets( other._example_offsets ),
+                                                  _regions( other._regions ),
+                                                  _values_data( other._values_data ),
+                                                  _cv_offsets_data( other._cv_offsets_data ),
+                                                  _example_offsets_data( other._example_offsets_data ),
+                                                  _num_rows( other._num_rows ) {
+  _sync();
+}
+
+LLM_Index_Table&
+LLM_Index_Table::
+operator=( const LLM_Index_Table& other ) {
+  _values = other._values;
+  _cv_offsets = other._cv_offsets;
+  _example_offsets = other._example_offsets;
+  _regions = other._regions;
+  _values_data = other._values_data;
+  _cv_offsets_data = other._cv_offsets_data;
+  _example_offsets_data = other._example_offsets_data;
+  _num_rows = other._num_rows;
+  _sync();
+  return (*this);
+}
+
+void
+LLM_Index_Table::
+clear( void ){
+  _values.clear();
+  _cv_offsets.assign( 1, 0 );
+  _example_offsets.assign( 1, 0 );
+  _regions.clear();
+  _sync();
+  return;
+}
+
+/**
+ * points the accessors at the arrays held in memory; mapped tables keep pointing into their regions
+ */
+void
+LLM_Index_Table::
+_sync( void ){
+  if( _regions.empty() ){
+    _values_data = _values.data();
+    _cv_offsets_data = _cv_offsets.data();
+    _example_offsets_data = _example_offsets.data();
+    _num_rows = _example_offsets.size() - 1;
+  }
+  return;
+}
+
+/**
+ * starts a new row; subsequent calls to push_cv() add the indices of its correspondence variables
+ */
+void
+LLM_Index_Table::
+push_row( void ){
+  assert( !mapped() );
+  _example_offsets.push_back( _example_offsets.back() );
+  _sync();
+  return;
+}
+
+void
+LLM_Index_Table::
+push_cv( const vector< unsigned int >& indices ){
+  _values.insert( _values.end(), indices.begin(), indices.end() );
+  _cv_offsets.push_back( _values.size() );
+  _example_offsets.back()++;
+  _sync();
+  return;
+}
+
+void
+LLM_Index_Table::
+append( const LLM_Index_Table& other ){
+  assert( !mapped() );
+  unsigned long long value_offset = _values.size();
+  unsigned long long cv_offset = _cv_offsets.size() - 1;
+  _values.insert( _values.end(), other.values(), other.values() + other.num_values() );
+  _cv_offsets.reserve( _cv_offsets.size() + other.num_cvs() );
+  for( unsigned long long i = 1; i <= other.num_cvs(); i++ ){
+    _cv_offsets.push_back( other.cv_offsets()[ i ] + value_offset );
+  }
+  _example_offsets.reserve( _example_offsets.size() + other.num_rows() );
+  for( unsigned int i = 1; i <= other.num_rows(); i++ ){
+    _example_offsets.push_back( other.example_offsets()[ i ] + cv_offset );
+  }
+  _sync();
+  return;
+}
+
+// version 2 stores the offsets as 64-bit integers, so caches of version 1 are no longer read
+static const char LLM_INDEX_TABLE_MAGIC[ 8 ] = { 'H', '2', 'S', 'L', 'I', 'D', 'X', '2' };
+
+/**
+ * the size in bytes of an entry of the values (0), cv offsets (1) and example offsets (2) arrays
+ */
+static const unsigned long long LLM_INDEX_TABLE_ENTRY_SIZES[ 3 ] = { sizeof( unsigned int ), sizeof( unsigned long long ), sizeof( unsigned long long ) };
+
+/**
+ * reads a table written by write(), returning false if the file is missing, truncated or was written for a different key
+ */
+bool
+LLM_Index_Table::
+read( const string& filename,
+      const string& key ){
+  ifstream in( filename.c_str(), ios::in | ios::binary );
+  if( !in.is_open() ){
+    return false;
+  }
+
+  char magic[ sizeof( LLM_INDEX_TABLE_MAGIC ) ];
+  unsigned long long key_size = 0;
+  in.read( magic, sizeof( magic ) );
+  in.read( ( char* )( &key_size ), sizeof( key_size ) );
+  if( !in.good() || ( memcmp( magic, LLM_INDEX_TABLE_MAGIC, sizeof( magic ) ) != 0 ) || ( key_size != key.size() ) ){
+    return false;
+  }
+  string file_key( key_size, '\0' );
+  in.read( &file_key[ 0 ], key_size );
+  if( !in.good() || ( file_key != key ) ){
+    return false;
+  }
+
+  _regions.clear();
+
+  unsigned long long sizes[ 3 ] = { 0, 0, 0 };
+  for( unsigned int i = 0; i < 3; i++ ){
+    in.read( ( char* )( &sizes[ i ] ), sizeof( sizes[ i ] ) );
+    if( !in.good() ){
+      clear();
+      return false;
+    }
+    char * data = NULL;
+    if( i == 0 ){
+      _values.resize( sizes[ i ] );
+      data = ( char* )( _values.data() );
+    } else {
+      vector< unsigned long long >& offsets = ( i == 1 ) ? _cv_offsets : _example_offsets;
+      offsets.resize( sizes[ i ] );
+      data = ( char* )( offsets.data() );
+    }
+    in.read( data, sizes[ i ] * LLM_INDEX_TABLE_ENTRY_SIZES[ i ] );
+    if( ( unsigned long long )( in.gcount() ) != sizes[ i ] * LLM_INDEX_TABLE_ENTRY_SIZES[ i ] ){
+      clear();
+      return false;
+    }
+  }
+
+  if( _cv_offsets.empty() || _example_offsets.empty() || ( _cv_offsets.back() != _values.size() ) || ( _example_offsets.back() + 1 != _cv_offsets.size() ) ){
+    clear();
+    return false;
+  }
+  _sync();
+  return true;
+}
+
+/**
+ * writes the table in native byte order behind a header holding the key it was computed for
+ */
+bool
+LLM_Index_Table::
+write( const string& filename,
+        const string& key )const{
+  ofstream out( filename.c_str(), ios::out | ios::binary | ios::trunc );
+  if( !out.is_open() ){
+    return false;
+  }
+
+  unsigned long long key_size = key.size();
+  out.write( LLM_INDEX_TABLE_MAGIC, sizeof( LLM_INDEX_TABLE_MAGIC ) );
+  out.write( ( const char* )( &key_size ), sizeof( key_size ) );
+  out.write( key.data(), key_size );
+
+  const void* arrays[ 3 ] = { values(), cv_offsets(), example_offsets() };
+  const unsigned long long sizes[ 3 ] = { num_values(), num_cvs() + 1, ( unsigned long long )( num_rows() ) + 1 };
+  for( unsigned int i = 0; i < 3; i++ ){
+    out.write( ( const char* )( &sizes[ i ] ), sizeof( sizes[ i ] ) );
+    out.write( ( const char* )( arrays[ i ] ), sizes[ i ] * LLM_INDEX_TABLE_ENTRY_SIZES[ i ] );
+  }
+  out.close();
+  return !out.fail();
+}
+
+/**
+ * maps the shard files written by an LLM_Index_Table_Writer in place of the arrays held in memory, 
+ * returning false if they are missing or inconsistent
+ */
+bool
+LLM_Index_Table::
+map( const string& prefix ){
+  vector< vector< string > > filenames( 3 );
+  vector< unsigned long long > offsets( 3, 0 );
+  vector< unsigned long long > sizes( 3, 0 );
+  for( unsigned int i = 0; i < 3; i++ ){
+    for( unsigned int j = 0; true; j++ ){
+      string filename = LLM_Index_Table_Writer::filename( prefix, i, j );
+      ifstream in( filename.c_str(), ios::in | ios::binary | ios::ate );
+      if( !in.is_open() ){
+        break;
+      }
+      sizes[ i ] += ( unsigned long long )( in.tellg() );
+      filenames[ i ].push_back( filename );
+    }
+    if( filenames[ i ].empty() ){
+      return false;
+    }
+  }
+  return _map( filenames, offsets, sizes );
+}
+
+/**
+ * maps the arrays of an index cache written by write() in place of reading them, returning false 
+ * if the file is missing, truncated or was written for a different key
+ */
+bool
+LLM_Index_Table::
+map( const string& filename,
+      const string& key ){
+  ifstream in( filename.c_str(), ios::in | ios::binary | ios::ate );
+  if( !in.is_open() ){
+    return false;
+  }
+  const unsigned long long file_size = ( unsigned long long )( in.tellg() );
+  in.seekg( 0, ios::beg );
+
+  char magic[ sizeof( LLM_INDEX_TABLE_MAGIC ) ];
+  unsigned long long key_size = 0;
+  in.read( magic, sizeof( magic ) );
+  in.read( ( char* )( &key_size ), sizeof( key_size ) );
+  if( !in.good() || ( memcmp( magic, LLM_INDEX_TABLE_MAGIC, sizeof( magic ) ) != 0 ) || ( key_size != key.size() ) ){
+    return false;
+  }
+  string file_key( key_size, '\0' );
+  in.read( &file_key[ 0 ], key_size );
+  if( !in.good() || ( file_key != key ) ){
+    return false;
+  }
+
+  vector< vector< string > > filenames( 3, vector< string >( 1, filename ) );
+  vector< unsigned long long > offsets( 3, 0 );
+  vector< unsigned long long > sizes( 3, 0 );
+  unsigned long long position = sizeof( magic ) + sizeof( key_size ) + key_size;
+  for( unsigned int i = 0; i < 3; i++ ){
+    unsigned long long size = 0;
+    in.seekg( position, ios::beg );
+    in.read( ( char* )( &size ), sizeof( size ) );
+    offsets[ i ] = position + sizeof( size );
+    sizes[ i ] = size * LLM_INDEX_TABLE_ENTRY_SIZES[ i ];
+    position = offsets[ i ] + sizes[ i ];
+    if( !in.good() || ( position > file_size ) ){
+      return false;
+    }
+  }
+  return _map( filenames, offsets, sizes );
+}
+
+/**
+ * maps the values, cv offsets and example offsets from the given byte ranges of their files
+ */
+bool
+LLM_Index_Table::
+_map( const vector< vector< string > >& filenames,
+      const vector< unsigned long long >& offsets,
+      const vector< unsigned long long >& sizes ){
+  vector< boost::shared_ptr< LLM_Index_Table_Region > > regions( 3 );
+  unsigned long long counts[ 3 ] = { 0, 0, 0 };
+  for( unsigned int i = 0; i < 3; i++ ){
+    regions[ i ].reset( new LLM_Index_Table_Region() );
+    if( ( sizes[ i ] % LLM_INDEX_TABLE_ENTRY_SIZES[ i ] != 0 ) || !regions[ i ]->map( filenames[ i ], offsets[ i ], sizes[ i ] ) ){
+      cout << "could not map " << filenames[ i ].front() << endl;
+      return false;
+    }
+    counts[ i ] = sizes[ i ] / LLM_INDEX_TABLE_ENTRY_SIZES[ i ];
+  }
+  const unsigned int * values = ( const unsigned int* )( regions[ 0 ]->data() );
+  const unsigned long long * cv_offsets = ( const unsigned long long* )( regions[ 1 ]->data() );
+  const unsigned long long * example_offsets = ( const unsigned long long* )( regions[ 2 ]->data() );
+
+  // only the values of a table without indices can be empty, and the rows are counted in 32 bits
+  if( ( counts[ 1 ] == 0 ) || ( counts[ 2 ] == 0 ) || ( counts[ 2 ] - 1 > numeric_limits< unsigned int >::max() ) || ( cv_offsets[ counts[ 1 ] - 1 ] != counts[ 0 ] ) || ( example_offsets[ counts[ 2 ] - 1 ] + 1 != counts[ 1 ] ) ){
+    return false;
+  }
+
+  _values.clear();
+  _cv_offsets.clear();
+  _example_offsets.clear();
+  _regions = regions;
+  _values_data = values;
+  _cv_offsets_data = cv_offsets;
+  _example_offsets_data = example_offsets;
+  _num_rows = counts[ 2 ] - 1;
+  return true;
+}
+
+/**
+ * asks the kernel to start reading the indices of rows [begin,end) of a mapped table
+ */
+void
+LLM_Index_Table::
+prefetch( const unsigned int& begin,
+          const unsigned int& end )const{
+  if( !mapped() || ( begin >= end ) ){
+    return;
+  }
+  const void* arrays[ 2 ] = { _values_data + _cv_offsets_data[ _example_offsets_data[ begin ] ], _cv_offsets_data + _example_offsets_data[ begin ] };
+  const void* lasts[ 2 ] = { _values_data + _cv_offsets_data[ _example_offsets_data[ end ] ], _cv_offsets_data + _example_offsets_data[ end ] + 1 };
+  const unsigned long page_size = boost::interprocess::mapped_region::get_page_size();
+  for( unsigned int i = 0; i < 2; i++ ){
+    unsigned long first = ( ( unsigned long )( arrays[ i ] ) / page_size ) * page_size;
+    unsigned long last = ( unsigned long )( lasts[ i ] );
+    if( last > first ){
+      posix_madvise( ( void* )( first ), last - first, POSIX_MADV_WILLNEED );
+    }
+  }
+  return;
+}
+
+LLM_Index_Table_Writer::
+LLM_Index_Table_Writer() : _prefix(),
+                            _shard_size( LLM_INDEX_TABLE_SHARD_SIZE ),
+                            _failed( false ),
+                            _num_values( 0 ),
+                            _num_cvs( 0 ),
+                            _num_rows( 0 ) {
+  for( unsigned int i = 0; i < 3; i++ ){
+    _shards[ i ] = 0;
+    _shard_bytes[ i ] = 0;
+  }
+}
+
+LLM_Index_Table_Writer::
+~LLM_Index_Table_Writer() {
+  close();
+}
+
+/**
+ * returns the name of a shard file, where array is 0 for the values, 1 for the cv offsets and 2 for the example offsets
+ */
+string
+LLM_Index_Table_Writer::
+filename( const string& prefix,
+          const unsigned int& array,
+          const unsigned int& shard ){
+  static const char* suffixes[ 3 ] = { ".values.", ".cv_offsets.", ".example_offsets." };
+  stringstream filename;
+  filename << prefix << suffixes[ array ] << shard;
+  return filename.str();
+}
+
+/**
+ * truncates the first shard of each array, removes the shards left behind by a larger table and writes 
+ * the leading offsets of an empty table; the shard size is rounded down to whole pages so that the 
+ * shards can be mapped next to each other
+ */
+bool
+LLM_Index_Table_Writer::
+open( const string& prefix,
+      const unsigned long long& shardSize ){
+  close();
+  const unsigned long long page_size = boost::interprocess::mapped_region::get_page_size();
+  _prefix = prefix;
+  _shard_size = max( page_size, ( shardSize / page_size ) * page_size );
+  _failed = false;
+  for( unsigned int i = 0; i < 3; i++ ){
+    for( unsigned int j = 1; remove( filename( prefix, i, j ).c_str() ) == 0; j++ ){
+    }
+    _shards[ i ] = 0;
+    _shard_bytes[ i ] = 0;
+    _files[ i ].open( filename( prefix, i, 0 ).c_str(), ios::out | ios::binary | ios::trunc );
+    _failed = _failed || !_files[ i ].good();
+  }
+  _num_values = 0;
+  _num_cvs = 0;
+  _num_rows = 0;
+  const unsigned long long zero = 0;
+  return _write( 1, &zero, sizeof( zero ) ) && _write( 2, &zero, sizeof( zero ) );
+}
+
+/**
+ * appends the rows of a table, rebasing its offsets onto the rows written so far; returns false 
+ * if a write failed or the number of rows would no longer fit the 32-bit row numbers
+ */
+bool
+LLM_Index_Table_Writer::
+append( const LLM_Index_Table& table ){
+  if( ( unsigned long long )( _num_rows ) + table.num_rows() > numeric_limits< unsigned int >::max() ){
+    cout << "the index table in " << _prefix << " would have more than " << numeric_limits< unsigned int >::max() << " rows" << endl;
+    _failed = true;
+    return false;
+  }
+  _write( 0, table.values(), table.num_values() * sizeof( unsigned int ) );
+  vector< unsigned long long > offsets( table.num_cvs() );
+  for( unsigned long long i = 0; i < table.num_cvs(); i++ ){
+    offsets[ i ] = table.cv_offsets()[ i + 1 ] + _num_values;
+  }
+  _write( 1, offsets.data(), offsets.size() * sizeof( unsigned long long ) );
+  offsets.resize( table.num_rows() );
+  for( unsigned int i = 0; i < table.num_rows(); i++ ){
+    offsets[ i ] = table.example_offsets()[ i + 1 ] + _num_cvs;
+  }
+  _write( 2, offsets.data(), offsets.size() * sizeof( unsigned long long ) );
+  _num_values += table.num_values();
+  _num_cvs += table.num_cvs();
+  _num_rows += table.num_rows();
+  return !_failed;
+}
+
+/**
+ * flushes and closes the files, returning false if any write failed
+ */
+bool
+LLM_Index_Table_Writer::
+close( void ){
+  if( !is_open() ){
+    return !_failed;
+  }
+  for( unsigned int i = 0; i < 3; i++ ){
+    _files[ i ].close();
+    _failed = _failed || _files[ i ].fail();
+  }
+  return !_failed;
+}
+
+/**
+ * appends size bytes to an array, starting its next shard whenever the current one is full
+ */
+bool
+LLM_Index_Table_Writer::
+_write( const unsigned int& array,
+        const void* data,
+        const unsigned long long& size ){
+  const char * bytes = ( const char* )( data );
+  unsigned long long remaining = size;
+  while( ( remaining > 0 ) && !_failed ){
+    if( _shard_bytes[ array ] == _shard_size ){
+      _files[ array ].close();
+      if( _files[ array ].fail() ){
+        _failed = true;
+        break;
+      }
+      _shards[ array ]++;
+      _shard_bytes[ array ] = 0;
+      _files[ array ].open( filename( _prefix, array, _shards[ array ] ).c_str(), ios::out | ios::binary | ios::trunc );
+    }
+    const unsigned long long count = min( remaining, _shard_size - _shard_bytes[ array ] );
+    _files[ array ].write( bytes, count );
+    _failed = !_files[ array ].good();
+    bytes += count;
+    remaining -= count;
+    _shard_bytes[ array ] += count;
+  }
+  return !_failed;
+}
+
+LLM_Gradient_Buffer::
+LLM_Gradient_Buffer( const unsigned int& size ) : _values( size, 0.0 ),
+                                                  _touched(),
+                                                  _flags( size, false ) {
+
+}
+
+LLM_Gradient_Buffer::
+~LLM_Gradient_Buffer() {
+
+}
+
+LLM_Gradient_Buffer::
+LLM_Gradient_Buffer( const LLM_Gradient_Buffer& other ) : _values( other._values ),
+                                                          _touched( other._touched ),
+                                                          _flags( other._flags ) {
+
+}
+
+LLM_Gradient_Buffer&
+LLM_Gradient_Buffer::
+operator=( const LLM_Gradient_Buffer& other ) {
+  _values = other._values;
+  _touched = other._touched;
+  _flags = other._flags;
+  return (*this);
+}
+
+void
+LLM_Gradient_Buffer::
+resize( const unsigned int& size ){
+  clear();
+  _values.resize( size, 0.0 );
+  _flags.resize( size, false );
+  return;
+}
+
+void
+LLM_Gradient_Buffer::
+clear( void ){
+  for( unsigned int i = 0; i < _touched.size(); i++ ){
+    _values[ _touched[ i ] ] = 0.0;
+    _flags[ _touched[ i ] ] = false;
+  }
+  _touched.clear();
+  return;
+}
+
+/**
+ * adds the touched entries of other into this buffer and clears other
+ */
+void
+LLM_Gradient_Buffer::
+merge( LLM_Gradient_Buffer& other ){
+  for( unsigned int i = 0; i < other._touched.size(); i++ ){
+    add( other._touched[ i ], other._values[ other._touched[ i ] ] );
+  }
+  other.clear();
+  return;
+}
+
+LLM::
+LLM( Feature_Set* featureSet ) : _weights(),
+                                  _feature_set( featureSet ){
+
+}
+
+LLM::
+~LLM() {
+
+}
+
+LLM::
+LLM( const LLM& other ) : _weights( other._weights ),
+                          _feature_set( other._feature_set ){
+
+}
+
+LLM&
+LLM::
+operator=( const LLM& other ) {
+  _weights = other._weights;
+  _feature_set = other._feature_set;
+  return (*this);
+}
+
+double
+LLM::
+pygx( const unsigned int& cv,
+      const LLM_X& x,
+      const vector< unsigned int >& cvs,
+      const vector< vector< unsigned int > >& indices ){
+  vector< double > dps( cvs.size(), 0.0 );
+  if( cvs.size() == indices.size() ){
+    for( unsigned int i = 0; i < cvs.size(); i++ ){
+      for( unsigned int j = 0; j < indices[ i ].size(); j++ ){
+        dps[ i ] += _weights[ indices[ i ][ j ] ];
+      }
+    }
+  }
+  return softmax( cv, cvs, dps );
+}
+
+double
+LLM::
+pygx( const unsigned int& cv,
+      const vector< unsigned int >& cvs,
+      const LLM_Index_Table& indices,
+      const unsigned int& row ){
+  if( pygx_scratch.get() == NULL ){
+    pygx_scratch.reset( new vector< double >() );
+  }
+  vector< double >& log_pygxs = *pygx_scratch;
+  log_pygx( indices, row, row + 1, log_pygxs );
+  double numerator = 0.0;
+  for( unsigned int i = 0; ( i < log_pygxs.size() ) && ( i < cvs.size() ); i++ ){
+    if( cv == cvs[ i ] ){
+      numerator += exp( log_pygxs[ i ] );
+    }
+  }
+  return numerator;
+}
+
+/**
+ * scores a batch of rows in two passes: the dot products of every correspondence variable are 
+ * gathered into one contiguous array, which is then normalized in place with a log-sum-exp
+ */
+void
+LLM::
+log_pygx( const LLM_Index_Table& indices,
+          const unsigned int& begin,
+          const unsigned int& end,
+          vector< double >& logPygxs )const{
+  const unsigned long long first_cv = indices.example_offsets()[ begin ];
+  const unsigned long long last_cv = indices.example_offsets()[ end ];
+  logPygxs.resize( last_cv - first_cv );
+
+  const double * weights = _weights.data();
+  const unsigned int * values = indices.values();
+  const unsigned long long * cv_offsets = indices.cv_offsets();
+  double * scores = logPygxs.data() - first_cv;
+  for( unsigned long long i = first_cv; i < last_cv; i++ ){
+    scores[ i ] = dot_product( weights, values + cv_offsets[ i ], values + cv_offsets[ i + 1 ] );
+  }
+
+  const unsigned long long * example_offsets = indices.example_offsets();
+  for( unsigned int i = begin; i < end; i++ ){
+    log_normalize( scores + example_offsets[ i ], example_offsets[ i + 1 ] - example_offsets[ i ] );
+  }
+  return;
+}
+
+/**
+ * scores the rows rows[ begin ] ... rows[ end - 1 ], which need not be contiguous, into consecutive 
+ * runs of logPygxs, one run per row in the order given
+ */
+void
+LLM::
+log_pygx( const LLM_Index_Table& indices,
+          const vector< unsigned int >& rows,
+          const unsigned int& begin,
+          const unsigned int& end,
+          vector< double >& logPygxs )const{
+  unsigned int num_scores = 0;
+  for( unsigned int i = begin; i < end; i++ ){
+    num_scores += indices.num_cvs( rows[ i ] );
+  }
+  logPygxs.resize( num_scores );
+
+  const double * weights = _weights.data();
+  double * scores = logPygxs.data();
+  for( unsigned int i = begin; i < end; i++ ){
+    const unsigned int num_cvs = indices.num_cvs( rows[ i ] );
+    for( unsigned int k = 0; k < num_cvs; k++ ){
+      scores[ k ] = dot_product( weights, indices.begin( rows[ i ], k ), indices.end( rows[ i ], k ) );
+    }
+    log_normalize( scores, num_cvs );
+    scores += num_cvs;
+  }
+  return;
+}
+
+/**
+ * returns the probability of cv given the dot products of each correspondence variable, 
+ * subtracting the largest dot product before exponentiating so that large weights cannot overflow
+ */
+double
+LLM::
+softmax( const unsigned int& cv,
+          const vector< unsigned int >& cvs,
+          const vector< double >& dps ){
+  if( dps.empty() ){
+    return 0.0;
+  }
+  double max_dp = dps[ 0 ];
+  for( unsigned int i = 1; i < dps.size(); i++ ){
+    max_dp = max( max_dp, dps[ i ] );
+  }
+  double numerator = 0.0;
+  double denominator = 0.0;
+  for( unsigned int i = 0; i < dps.size(); i++ ){
+    double tmp = exp( dps[ i ] - max_dp );
+    if( cv == cvs[ i ] ){
+      numerator += tmp;
+    }
+    denominator += tmp;
+  }
+  return ( numerator / denominator );
+}
+
+double
+LLM::
+pygx( const unsigned int& cv,
+      const LLM_X& x,
+      const vector< unsigned int >& cvs,
+      vector< unsigned int >& indices ){
+  vector< double > dps( cvs.size(), 0.0 );
+  vector< unsigned int > tmp;
+  vector< Feature* > tmp_features;
+  vector< bool > evaluate_feature_types( NUM_FEATURE_TYPES, true );
+  for( unsigned int i = 0; i < cvs.size(); i++ ){
+    if( i != 0 ){
+      evaluate_feature_types[ FEATURE_TYPE_LANGUAGE ] = false;
+      evaluate_feature_types[ FEATURE_TYPE_GROUNDING ] = false;
+    }
+    double dp = 0.0;
+    _feature_set->indices( cvs[ i ], x.grounding(), x.children(), x.phrase(), x.world(), tmp, tmp_features, evaluate_feature_types );
+    for( unsigned int j = 0; j < tmp.size(); j++ ){
+      dp += _weights[ tmp[ j ] ];
+    }
+    dps[ i ] = dp;
+    if( cv == cvs[ i ] ){
+      indices = tmp;
+    }
+  }
+  return softmax( cv, cvs, dps );
+}
+
+double
+LLM::
+pygx( const unsigned int& cv,
+      const LLM_X& x,
+      const vector< unsigned int >& cvs,
+      vector< Feature* >& features ){
+  vector< double > dps( cvs.size(), 0.0 );
+  vector< unsigned int > indices;
+  vector< bool > evaluate_feature_types( NUM_FEATURE_TYPES, true );
+  for( unsigned int i = 0; i < cvs.size(); i++ ){
+    if( i != 0 ){
+      evaluate_feature_types[ FEATURE_TYPE_LANGUAGE ] = false;
+      evaluate_feature_types[ FEATURE_TYPE_GROUNDING ] = false; 
+    }
+    double dp = 0.0;
+    _feature_set->indices( cvs[ i ], x.grounding(), x.children(), x.phrase(), x.world(), indices, features, evaluate_feature_types );
+    for( unsigned int j = 0; j < indices.size(); j++ ){
+      dp += _weights[ indices[ j ] ];
+    }
+    dps[ i ] = dp;
+  }
+  return softmax( cv, cvs, dps );
+}
+
+double
+LLM::
+pygx( const unsigned int& cv,
+      const Grounding* grounding,
+      const vector< pair< const Phrase*, vector< Grounding* > > >& children,
+      const Phrase* phrase,
+      const World* world,
+      const vector< unsigned int >& cvs ){
+  vector< double > dps( cvs.size(), 0.0 );
+  vector< unsigned int > indices;
+  vector< Feature* > features;
+  vector< bool > evaluate_feature_types( NUM_FEATURE_TYPES, true );
+  for( unsigned int i = 0; i < cvs.size(); i++ ){
+    if( i != 0 ){
+      evaluate_feature_types[ FEATURE_TYPE_LANGUAGE ] = false;
+      evaluate_feature_types[ FEATURE_TYPE_GROUNDING ] = false;
+    }
+    double dp = 0.0;
+    _feature_set->indices( cvs[ i ], grounding, children, phrase, world, indices, features, evaluate_feature_types );
+    for( unsigned int j = 0; j < indices.size(); j++ ){
+      dp += _weights[ indices[ j ] ];
+    }
+    dps[ i ] = dp;
+  }
+  return softmax( cv, cvs, dps );
+}
+
+double
+LLM::
+pygx( const unsigned int& cv,
+      const Grounding* grounding,
+      const vector< pair< const Phrase*, vector< Grounding* > > >& children,
+      const Phrase* phrase,
+      const World* world,
+      const vector< unsigned int >& cvs,
+      const vector< bool >& evaluateFeatureTypes ){
+  vector< double > dps( cvs.size(), 0.0 );
+  vector< unsigned int > indices;
+  vector< Feature* > features;
+  vector< bool > evaluate_feature_types = evaluateFeatureTypes;
+  for( unsigned int i = 0; i < cvs.size(); i++ ){
+    if( i != 0 ){
+      evaluate_feature_types[ FEATURE_TYPE_LANGUAGE ] = false;
+      evaluate_feature_types[ FEATURE_TYPE_GROUNDING ] = false;
+    }
+    double dp = 0.0;
+    _feature_set->indices( cvs[ i ], grounding, children, phrase, world, indices, features, evaluate_feature_types );
+    for( unsigned int j = 0; j < indices.size(); j++ ){
+      dp += _weights[ indices[ j ] ];
+    }
+    dps[ i ] = dp;
+  }
+  return softmax( cv, cvs, dps );
+}
+
+/**
+ * indexes the examples and trains on them, returning false if they could not be indexed
+ */
+bool
+LLM_Train::
+train( const LLM_Example_Set& examples,
+        const unsigned int& maxIterations,
+        const double& lambda,
+        const double& epsilon ){
+  if( !prepare( examples ) ){
+    return false;
+  }
+  optimize( maxIterations, lambda, epsilon );
+  return true;
+}
+
+/**
+ * computes the indices of the examples so that optimize() can be called, possibly several times 
+ * and from copies of this trainer, which share the index table; returns false if they could not be indexed
+ */
+bool
+LLM_Train::
+prepare( const LLM_Example_Set& examples ){
+  return clear_examples() && add_examples( examples ) && prepare();
+}
+
+/**
+ * starts a new index table, which is read from the index cache when it has one for this key or 
+ * written to the out-of-core files when they are set; with both, a matching cache is mapped rather 
+ * than read. returns false if the out-of-core files cannot be created
+ */
+bool
+LLM_Train::
+clear_examples( void ){
+  // copies of this trainer may share the old table, so a new one is allocated rather than cleared
+  _indices.reset( new LLM_Index_Table() );
+  _cells.clear();
+  _shards.clear();
+  _num_examples = 0;
+  _num_groups = 0;
+  _cached = false;
+  _index_seconds = 0.0;
+  _index_busy.clear();
+  _index_writer.reset();
+  _cv_sets.clear();
+
+  if( !_out_of_core.empty() && !_index_cache.empty() && _indices->map( _index_cache, _index_cache_key ) ){
+    cout << "mapped indices for " << _indices->num_rows() << " examples from " << _index_cache << endl;
+    _cached = true;
+  } else if( !_out_of_core.empty() ){
+    _index_writer.reset( new LLM_Index_Table_Writer() );
+    if( !_index_writer->open( _out_of_core ) ){
+      cout << "could not write indices to " << _out_of_core << endl;
+      _index_writer.reset();
+      return false;
+    }
+  } else if( !_index_cache.empty() ){
+    if( _indices->read( _index_cache, _index_cache_key ) ){
+      cout << "read indices for " << _indices->num_rows() << " examples from " << _index_cache << endl;
+      _cached = true;
+    } else {
+      _indices->clear();
+    }
+  }
+  return true;
+}
+
+/**
+ * labels the examples and appends their feature indices to the index table; nothing refers to the 
+ * examples afterwards, so they can be discarded while the next batch is generated. returns false 
+ * if the indices could not be written to the out-of-core files
+ */
+bool
+LLM_Train::
+add_examples( const LLM_Example_Set& examples ){
+  if( _llms.front()->feature_set()->size() != _llms.front()->weights().size() ){
+    _llms.front()->weights().resize( _llms.front()->feature_set()->size(), 0.0 );
+  }
+
+  struct timeval start_time;
+  gettimeofday( &start_time, NULL );
+
+  // the phrases are only alive while the examples are, so they are numbered here in the order they first appear
+  vector< unsigned int > groups( examples.num_phrases(), numeric_limits< unsigned int >::max() );
+  unsigned int num_groups = 0;
+  // there are only a handful of distinct candidate sets, so they are looked up linearly
+  map< unsigned int, unsigned int > cv_sets;
+  _cells.reserve( _cells.size() + examples.size() );
+  for( unsigned int i = 0; i < examples.size(); i++ ){
+    const vector< unsigned int >& cvs = examples.cvs( examples[ i ].cvs );
+    assert( cvs.size() <= sizeof( unsigned int ) * 8 );
+    unsigned int labels = 0;
+    for( unsigned int k = 0; k < cvs.size(); k++ ){
+      if( cvs[ k ] == examples[ i ].cv ){
+        labels |= ( 1u << k );
+      }
+    }
+    if( groups[ examples[ i ].phrase ] == numeric_limits< unsigned int >::max() ){
+      groups[ examples[ i ].phrase ] = _num_groups + num_groups++;
+    }
+    map< unsigned int, unsigned int >::iterator it = cv_sets.find( examples[ i ].cvs );
+    if( it == cv_sets.end() ){
+      unsigned int id = find( _cv_sets.begin(), _cv_sets.end(), cvs ) - _cv_sets.begin();
+      if( id == _cv_sets.size() ){
+        _cv_sets.push_back( cvs );
+      }
+      it = cv_sets.insert( pair< unsigned int, unsigned int >( examples[ i ].cvs, id ) ).first;
+    }
+    _cells.push_back( LLM_Index_Map_Cell( _num_examples + i, examples[ i ].cv, labels, groups[ examples[ i ].phrase ], 1.0, it->second ) );
+  }
+  _num_examples += examples.size();
+  _num_groups += num_groups;
+
+  if( _cached ){
+    return true;
+  }
+
+  // the cost of feature extraction is not known in advance, so the workers steal fixed-size chunks
+  vector< pair< unsigned int, unsigned int > > chunks;
+  for( unsigned int i = 0; i < examples.size(); i += _chunk_size ){
+    chunks.push_back( pair< unsigned int, unsigned int >( i, min( ( unsigned int )( examples.size() ), i + _chunk_size ) ) );
+  }
+
+  vector< LLM_Index_Table > chunk_indices( chunks.size() );
+  Work_Queue queue( chunks.size() );
+  vector< boost::function< void( void ) > > jobs;
+  for( unsigned int i = 0; i < _llms.size(); i++ ){
+    jobs.push_back( boost::bind( LLM_Train::compute_indices_worker, boost::cref( examples ), boost::cref( chunks ), boost::ref( chunk_indices ), boost::ref( queue ), _llms[ i ] ) );
+  }
+
+  _run_jobs( jobs );
+
+  // the chunks are contiguous ranges of the examples, so their rows concatenate in table order
+  for( unsigned int i = 0; i < chunk_indices.size(); i++ ){
+    if( _index_writer.get() != NULL ){
+      if( !_index_writer->append( chunk_indices[ i ] ) ){
+        cout << "could not write indices to " << _out_of_core << endl;
+        return false;
+      }
+    } else {
+      _indices->append( chunk_indices[ i ] );
+    }
+    chunk_indices[ i ] = LLM_Index_Table();
+  }
+  assert( ( _index_writer.get() != NULL ? _index_writer->num_rows() : _indices->num_rows() ) == _cells.size() );
+
+  struct timeval end_time;
+  gettimeofday( &end_time, NULL );
+  _index_seconds += diff_time( start_time, end_time );
+  _index_busy.resize( max( _index_busy.size(), _job_seconds.size() ), 0.0 );
+  for( unsigned int i = 0; i < _job_seconds.size(); i++ ){
+    _index_busy[ i ] += _job_seconds[ i ];
+  }
+  return true;
+}
+
+/**
+ * finishes the index table once every example was added: writes the index cache, subsamples and 
+ * merges rows when asked to and partitions the table between the threads. returns false if the 
+ * cached indices do not match the examples, the out-of-core files cannot be mapped, duplicates 
+ * are to be merged while row or held-out ranges are set or the rows of out-of-core indices are to 
+ * be merged or subsampled
+ */
+bool
+LLM_Train::
+prepare( void ){
+  // merging renumbers the rows, so ranges of rows would no longer select the same examples
+  if( _deduplicate && ( !_row_ranges.empty() || !_holdout_ranges.empty() ) ){
+    cout << "duplicates cannot be merged when row or held-out ranges are set" << endl;
+    return false;
+  }
+
+  // merging and subsampling rebuild the table in memory, which would defeat mapping it
+  if( !_out_of_core.empty() && ( _deduplicate || ( _negatives > 0 ) ) ){
+    cout << "duplicates cannot be merged nor negatives subsampled when the indices are out of core" << endl;
+    return false;
+  }
+
+  if( _llms.front()->feature_set()->size() != _llms.front()->weights().size() ){
+    _llms.front()->weights().resize( _llms.front()->feature_set()->size(), 0.0 );
+  }
+  _gradient.resize( _llms.front()->weights().size() );
+
+  if( _cached && ( _indices->num_rows() != _cells.size() ) ){
+    cout << "the indices in " << _index_cache << " are for " << _indices->num_rows() << " examples, not " << _cells.size() << ", remove it and retrain" << endl;
+    return false;
+  }
+
+  // the objective and gradient passes read the mapped files, so only the pages in use stay resident
+  if( _index_writer.get() != NULL ){
+    if( !_index_writer->close() || !_indices->map( _out_of_core ) || ( _indices->num_rows() != _cells.size() ) ){
+      cout << "could not map the indices in " << _out_of_core << endl;
+      _index_writer.reset();
+      return false;
+    }
+    _index_writer.reset();
+    cout << "mapped indices for " << _indices->num_rows() << " examples from " << _out_of_core << endl;
+  }
+
+  if( _verbose ){
+    cout << "indexed " << _num_examples << " examples with " << _indices->num_values() << " feature indices" << endl;
+  }
+
+  if( !_cached && !_index_cache.empty() ){
+    if( _indices->write( _index_cache, _index_cache_key ) ){
+      cout << "wrote indices to " << _index_cache << endl;
+    } else {
+      cout << "could not write indices to " << _index_cache << endl;
+    }
+  }
+
+  _subsample_negatives();
+  if( _deduplicate ){
+    _merge_duplicates();
+  }
+
+  if( _telemetry != NULL ){
+    double index_table_mb = ( double )( _indices->num_values() * sizeof( unsigned int ) + ( _indices->num_cvs() + _indices->num_rows() + 2 ) * sizeof( unsigned long long ) ) / ( 1024.0 * 1024.0 );
+    _telemetry->write( "indices", Telemetry_Record().add( "examples", _num_examples ).add( "rows", _indices->num_rows() ).add( "values", _indices->num_values() ).add( "index_table_mb", index_table_mb ).add( "seconds", _index_seconds ).add( "busy", _index_busy ).add( "mapped", ( double )( _indices->mapped() ) ).add( "max_rss_mb", Telemetry::max_rss() ) );
+  }
+
+  partition( _llms.size() );
+  return true;
+}
+
+void
+LLM_Train::
+optimize( const unsigned int& maxIterations,
+          const double& lambda,
+          const double& epsilon ){
+  _lambda = lambda;
+
+  if( _llms.front()->weights().size() != _gradient.size() ){
+    _llms.front()->weights().resize( _gradient.size(), 0.0 );
+  }
+  if( !_prior.empty() && ( _prior.size() != _llms.front()->weights().size() ) ){
+    cout << "ignoring prior with " << _prior.size() << " weights (expected " << _llms.front()->weights().size() << ")" << endl;
+    _prior.clear();
+  }
+
+  struct timeval start_time;
+  gettimeofday( &start_time, NULL );
+  const unsigned int num_evaluations = _num_evaluations;
+
+  if( ( _process_group != NULL ) && _process_group->is_coordinator() && ( _optimizer != LLM_TRAIN_OPTIMIZER_LBFGS ) ){
+    cout << "training across processes only supports lbfgs, using lbfgs" << endl;
+    _optimizer = LLM_TRAIN_OPTIMIZER_LBFGS;
+  }
+
+  if( !_holdout_ranges.empty() ){
+    _holdout = new LLM_Holdout( *_indices, _cells, _holdout_ranges, max( 1u, _patience ) );
+    if( _holdout_interval == 0 ){
+      _holdout_interval = 1;
+    }
+  }
+
+  switch( _optimizer ){
+  case( LLM_TRAIN_OPTIMIZER_SGD ):
+  case( LLM_TRAIN_OPTIMIZER_ADAGRAD ):
+    _train_stochastic( maxIterations, lambda, epsilon );
+    break;
+  case( LLM_TRAIN_OPTIMIZER_LBFGS ):
+  default:
+    _train_lbfgs( maxIterations, epsilon );
+    break;
+  }
+
+  if( _holdout != NULL ){
+    _restore_best_holdout_weights();
+    delete _holdout;
+    _holdout = NULL;
+  }
+
+  if( _telemetry != NULL ){
+    struct timeval end_time;
+    gettimeofday( &end_time, NULL );
+    string optimizer = ( _optimizer == LLM_TRAIN_OPTIMIZER_SGD ) ? "sgd" : ( ( _optimizer == LLM_TRAIN_OPTIMIZER_ADAGRAD ) ? "adagrad" : "lbfgs" );
+    _telemetry->write( "optimize", Telemetry_Record().add( "optimizer", optimizer ).add( "lambda", lambda ).add( "prior_lambda", _prior.empty() ? 0.0 : _prior_lambda ).add( "l1", _l1 ).add( "objective", _final_objective ).add( "evaluations", _num_evaluations - num_evaluations ).add( "seconds", diff_time( start_time, end_time ) ).add( "max_rss_mb", Telemetry::max_rss() ) );
+  }
+
+  return;
+}
+
+/**
+ * counts the examples, weighted by their cells, in rows [begin,end) of the index table whose most likely correspondence variable is the labeled one
+ */
+double
+LLM_Train::
+num_correct( const LLM* llm,
+              const unsigned int& begin,
+              const unsigned int& end )const{
+  double num_correct = 0.0;
+  vector< double > log_pygxs;
+  for( unsigned int batch = begin; batch < end; batch += 256 ){
+    const unsigned int batch_end = min( end, batch + 256 );
+    llm->log_pygx( *_indices, batch, batch_end, log_pygxs );
+    const double * log_pygx = log_pygxs.data();
+    for( unsigned int i = batch; i < batch_end; i++ ){
+      const unsigned int num_cvs = _indices->num_cvs( i );
+      unsigned int best = 0;
+      for( unsigned int k = 1; k < num_cvs; k++ ){
+        if( log_pygx[ k ] > log_pygx[ best ] ){
+          best = k;
+        }
+      }
+      if( ( num_cvs > 0 ) && _cells[ i ].is_label( best ) ){
+        num_correct += _cells[ i ].weight();
+      }
+      log_pygx += _indices->num_cvs( i );
+    }
+  }
+  return num_correct;
+}
+
+/**
+ * scores every row of the index table across the threads and accumulates one evaluation per range 
+ * of examples, e.g. per file; a row is counted in the range of its (first) example and rows outside 
+ * of every range are skipped. the chunks are merged in order, so the sums do not depend on the threads
+ */
+void
+LLM_Train::
+evaluate( const LLM* llm,
+          const vector< pair< unsigned int, unsigned int > >& ranges,
+          vector< llm_evaluation_t >& evaluations ){
+  llm_evaluation_t empty;
+  memset( &empty, 0, sizeof( empty ) );
+  evaluations.assign( ranges.size(), empty );
+
+  vector< pair< unsigned int, unsigned int > > chunks;
+  for( unsigned int i = 0; i < _indices->num_rows(); i += _chunk_size ){
+    chunks.push_back( pair< unsigned int, unsigned int >( i, min( _indices->num_rows(), i + _chunk_size ) ) );
+  }
+
+  vector< vector< pair< unsigned int, llm_evaluation_t > > > chunk_evaluations( chunks.size() );
+  Work_Queue queue( chunks.size() );
+  vector< boost::function< void( void ) > > jobs;
+  for( unsigned int i = 0; i < _llms.size(); i++ ){
+    jobs.push_back( boost::bind( LLM_Train::compute_evaluation_worker, boost::cref( chunks ), boost::cref( _cells ), boost::cref( *_indices ), boost::cref( _cv_sets ), boost::cref( ranges ), llm, boost::ref( queue ), boost::ref( chunk_evaluations ) ) );
+  }
+
+  _run_jobs( jobs );
+
+  for( unsigned int i = 0; i < chunk_evaluations.size(); i++ ){
+    for( unsigned int j = 0; j < chunk_evaluations[ i ].size(); j++ ){
+      llm_evaluation_t& evaluation = evaluations[ chunk_evaluations[ i ][ j ].first ];
+      const llm_evaluation_t& partial = chunk_evaluations[ i ][ j ].second;
+      evaluation.num_examples += partial.num_examples;
+      evaluation.num_correct += partial.num_correct;
+      evaluation.log_loss += partial.log_loss;
+      for( unsigned int a = 0; a < NUM_CVS; a++ ){
+        for( unsigned int b = 0; b < NUM_CVS; b++ ){
+          evaluation.confusion[ a ][ b ] += partial.confusion[ a ][ b ];
+        }
+      }
+    }
+  }
+  return;
+}
+
+/**
+ * pulls chunks of rows off the shared queue and evaluates each into a list of partial evaluations, 
+ * one per range that the rows of the chunk fall into
+ */
+void
+LLM_Train::
+compute_evaluation_worker( const vector< pair< unsigned int, unsigned int > >& chunks,
+                            const vector< LLM_Index_Map_Cell >& cells,
+                            const LLM_Index_Table& indices,
+                            const vector< vector< unsigned int > >& cvSets,
+                            const vector< pair< unsigned int, unsigned int > >& ranges,
+                            const LLM* llm,
+                            Work_Queue& queue,
+                            vector< vector< pair< unsigned int, llm_evaluation_t > > >& evaluations ){
+  llm_evaluation_t empty;
+  memset( &empty, 0, sizeof( empty ) );
+  vector< double > log_pygxs;
+  unsigned int chunk = 0;
+  while( queue.next( chunk ) ){
+    llm->log_pygx( indices, chunks[ chunk ].first, chunks[ chunk ].second, log_pygxs );
+    const double * log_pygx = log_pygxs.data();
+    unsigned int range = ranges.size();
+    for( unsigned int i = chunks[ chunk ].first; i < chunks[ chunk ].second; i++ ){
+      const LLM_Index_Map_Cell& cell = cells[ i ];
+      const unsigned int num_cvs = indices.num_cvs( i );
+      if( ( range == ranges.size() ) || ( cell.index() < ranges[ range ].first ) || ( cell.index() >= ranges[ range ].second ) ){
+        range = ranges.size();
+        for( unsigned int r = 0; r < ranges.size(); r++ ){
+          if( ( cell.index() >= ranges[ r ].first ) && ( cell.index() < ranges[ r ].second ) ){
+            range = r;
+            break;
+          }
+        }
+        if( range < ranges.size() ){
+          evaluations[ chunk ].push_back( pair< unsigned int, llm_evaluation_t >( range, empty ) );
+        }
+      }
+      if( ( range < ranges.size() ) && ( num_cvs > 0 ) ){
+        llm_evaluation_t& evaluation = evaluations[ chunk ].back().second;
+        unsigned int best = 0;
+        double pygx = 0.0;
+        for( unsigned int k = 0; k < num_cvs; k++ ){
+          if( log_pygx[ k ] > log_pygx[ best ] ){
+            best = k;
+          }
+          if( cell.is_label( k ) ){
+            pygx += exp( log_pygx[ k ] );
+          }
+        }
+        evaluation.num_examples += cell.weight();
+        if( cell.is_label( best ) ){
+          evaluation.num_correct += cell.weight();
+        }
+        evaluation.log_loss -= cell.weight() * log( max( pygx, numeric_limits< double >::min() ) );
+        const vector< unsigned int >& cvs = cvSets[ cell.cvs() ];
+        if( ( cell.cv() < NUM_CVS ) && ( best < cvs.size() ) && ( cvs[ best ] < NUM_CVS ) ){
+          evaluation.confusion[ cell.cv() ][ cvs[ best ] ] += cell.weight();
+        }
+      }
+      log_pygx += num_cvs;
+    }
+  }
+  return;
+}
+
+void
+LLM_Train::
+_train_lbfgs( const unsigned int& maxIterations,
+              const double& epsilon ){
+  lbfgsfloatval_t fx;
+  lbfgsfloatval_t * x = lbfgs_malloc( _llms.front()->feature_set()->size() );
+
+  for( unsigned int i = 0; i < _llms.front()->weights().size(); i++ ){
+    x[ i ] = _llms.front()->weights()[ i ];
+  }
+
+  lbfgs_parameter_t param;
+  lbfgs_parameter_init(&param);
+  param.epsilon = epsilon;
+  param.max_iterations = maxIterations;
+  if( _l1 > 0.0 ){
+    // OWL-QN, which liblbfgs only supports with a backtracking line search
+    param.orthantwise_c = _l1;
+    param.orthantwise_start = 0;
+    param.orthantwise_end = _llms.front()->weights().size();
+    param.linesearch = LBFGS_LINESEARCH_BACKTRACKING;
+  }
+
+  lbfgs( _llms.front()->weights().size(), x, &fx, ::evaluate, progress, ( void* )( this ), &param );
+  _final_objective = -fx;
+
+  for( unsigned int i = 0; i < _llms.front()->weights().size(); i++ ){
+    _llms.front()->weights()[ i ] = x[ i ];
   }
 
   lbfgs_free( x );
@@ -364,6 +1936,169 @@ train( vector< pair< unsigned int, LLM_X > >& examples,
   return;
 }
 
+/**
+ * minibatch stochastic gradient ascent (plain or AdaGrad) on the regularized log-likelihood;
+ * the L2 terms decay the weights towards zero, or towards a point between zero and the prior 
+ * when one is set, and the L1 term is applied as a soft threshold after each step;
+ * a weight only decays when a minibatch reads it, at which point the skipped decay steps are 
+ * applied at once, so each step costs time proportional to the minibatch rather than the model
+ */
+void
+LLM_Train::
+_train_stochastic( const unsigned int& maxIterations,
+                    const double& lambda,
+                    const double& epsilon ){
+  vector< double >& weights = _llms.front()->weights();
+  vector< unsigned int > order;
+  vector< pair< unsigned int, unsigned int > > ranges = _training_ranges();
+  for( unsigned int r = 0; r < ranges.size(); r++ ){
+    for( unsigned int i = ranges[ r ].first; i < ranges[ r ].second; i++ ){
+      order.push_back( i );
+    }
+  }
+  const unsigned int num_rows = order.size();
+  if( num_rows == 0 ){
+    return;
+  }
+  const unsigned int batch_size = max( 1u, min( _batch_size, num_rows ) );
+  // lambda / 2 w^2 + prior_lambda / 2 ( w - prior )^2 is strength / 2 ( w - center )^2 plus a constant
+  const double strength = lambda + ( _prior.empty() ? 0.0 : _prior_lambda );
+  vector< double > center;
+  if( !_prior.empty() && ( strength > 0.0 ) ){
+    center.resize( _prior.size() );
+    for( unsigned int i = 0; i < _prior.size(); i++ ){
+      center[ i ] = _prior_lambda * _prior[ i ] / strength;
+    }
+  }
+  const double decay = strength / ( double )( num_rows );
+  const double shrink = _l1 / ( double )( num_rows );
+  const bool adagrad = ( _optimizer == LLM_TRAIN_OPTIMIZER_ADAGRAD );
+
+  vector< unsigned int > last_update( weights.size(), 0 );
+  vector< double > sum_squares( weights.size(), 0.0 );
+  boost::random::mt19937 generator( _seed );
+
+  // in deterministic mode a minibatch is always split into the same pieces, which are merged in order
+  const unsigned int num_pieces = _deterministic ? LLM_TRAIN_DETERMINISTIC_PIECES : _llms.size();
+  vector< LLM_Gradient_Buffer > gradients( num_pieces, LLM_Gradient_Buffer( weights.size() ) );
+  vector< double > objectives( num_pieces, 0.0 );
+  vector< vector< double > > scores( num_pieces );
+
+  unsigned int step = 0;
+  double previous_objective = 0.0;
+  for( unsigned int epoch = 1; epoch <= maxIterations; epoch++ ){
+    struct timeval start_time;
+    gettimeofday( &start_time, NULL );
+    // one entry per piece of a minibatch, which is one per thread unless the pieces are fixed
+    vector< double > busy( num_pieces, 0.0 );
+
+    for( unsigned int i = num_rows - 1; i > 0; i-- ){
+      boost::random::uniform_int_distribution< unsigned int > distribution( 0, i );
+      swap( order[ i ], order[ distribution( generator ) ] );
+    }
+
+    double objective = 0.0;
+    for( unsigned int batch = 0; batch < num_rows; batch += batch_size ){
+      const unsigned int batch_end = min( num_rows, batch + batch_size );
+      step++;
+
+      // catch up on the decay skipped by the weights that this minibatch reads
+      for( unsigned int i = batch; i < batch_end; i++ ){
+        const unsigned int* first = _indices->begin( order[ i ], 0 );
+        const unsigned int* last = first + _indices->num_values( order[ i ] );
+        for( const unsigned int* index = first; index != last; index++ ){
+          if( last_update[ *index ] + 1 < step ){
+            double rate = adagrad ? _learning_rate / sqrt( sum_squares[ *index ] + 1e-8 ) : _learning_rate;
+            double prior = center.empty() ? 0.0 : center[ *index ];
+            weights[ *index ] = prior + ( weights[ *index ] - prior ) * pow( max( 0.0, 1.0 - rate * decay ), ( double )( step - 1 - last_update[ *index ] ) );
+            weights[ *index ] = soft_threshold( weights[ *index ], rate * shrink * ( double )( step - 1 - last_update[ *index ] ) );
+            last_update[ *index ] = step - 1;
+          }
+        }
+      }
+
+      vector< boost::function< void( void ) > > jobs;
+      const unsigned int span = ( batch_end - batch + num_pieces - 1 ) / num_pieces;
+      for( unsigned int i = 0; i < num_pieces; i++ ){
+        const unsigned int begin = min( batch_end, batch + i * span );
+        const unsigned int end = min( batch_end, begin + span );
+        jobs.push_back( boost::bind( LLM_Train::compute_minibatch_thread, boost::cref( order ), begin, end, boost::cref( _cells ), boost::cref( *_indices ), _llms.front(), boost::ref( objectives[ i ] ), boost::ref( gradients[ i ] ), boost::ref( scores[ i ] ) ) );
+      }
+
+      _run_jobs( jobs );
+      for( unsigned int i = 0; ( i < _job_seconds.size() ) && ( i < busy.size() ); i++ ){
+        busy[ i ] += _job_seconds[ i ];
+      }
+
+      for( unsigned int i = 1; i < gradients.size(); i++ ){
+        gradients.front().merge( gradients[ i ] );
+      }
+      for( unsigned int i = 0; i < objectives.size(); i++ ){
+        objective += objectives[ i ];
+      }
+
+      const vector< unsigned int >& touched = gradients.front().touched();
+      for( unsigned int i = 0; i < touched.size(); i++ ){
+        const unsigned int& index = touched[ i ];
+        double gradient = gradients.front().values()[ index ] / ( double )( batch_end - batch );
+        double rate = _learning_rate;
+        if( adagrad ){
+          sum_squares[ index ] += gradient * gradient;
+          rate = _learning_rate / sqrt( sum_squares[ index ] + 1e-8 );
+        }
+        double prior = center.empty() ? 0.0 : center[ index ];
+        weights[ index ] = prior + max( 0.0, 1.0 - rate * decay ) * ( weights[ index ] - prior ) + rate * gradient;
+        weights[ index ] = soft_threshold( weights[ index ], rate * shrink );
+        last_update[ index ] = step;
+      }
+      gradients.front().clear();
+    }
+
+    double xnorm = 0.0;
+    for( unsigned int i = 0; i < weights.size(); i++ ){
+      if( last_update[ i ] < step ){
+        double rate = adagrad ? _learning_rate / sqrt( sum_squares[ i ] + 1e-8 ) : _learning_rate;
+        double prior = center.empty() ? 0.0 : center[ i ];
+        weights[ i ] = prior + ( weights[ i ] - prior ) * pow( max( 0.0, 1.0 - rate * decay ), ( double )( step - last_update[ i ] ) );
+        weights[ i ] = soft_threshold( weights[ i ], rate * shrink * ( double )( step - last_update[ i ] ) );
+        last_update[ i ] = step;
+      }
+      double offset = _prior.empty() ? 0.0 : weights[ i ] - _prior[ i ];
+      objective -= lambda / 2.0 * weights[ i ] * weights[ i ] + _prior_lambda / 2.0 * offset * offset + _l1 * fabs( weights[ i ] );
+      xnorm += weights[ i ] * weights[ i ];
+    }
+
+    _final_objective = objective;
+    if( _telemetry != NULL ){
+      struct timeval end_time;
+      gettimeofday( &end_time, NULL );
+      _telemetry->write( "epoch", Telemetry_Record().add( "epoch", epoch ).add( "objective", objective ).add( "xnorm", sqrt( xnorm ) ).add( "steps", step ).add( "seconds", diff_time( start_time, end_time ) ).add( "pieces", num_pieces ).add( "busy", busy ).add( "max_rss_mb", Telemetry::max_rss() ) );
+    }
+    if( _verbose ){
+      cout << setw(3) << setfill(' ') << epoch << " " << setw(8) << setfill(' ') << objective << " (" << sqrt( xnorm ) << ")" << endl;
+    }
+
+    if( _holdout != NULL ){
+      if( ( epoch % _holdout_interval ) == 0 ){
+        _holdout->submit( epoch, weights.data(), weights.size() );
+      }
+      if( _holdout->plateaued() ){
+        break;
+      }
+    }
+
+    if( ( epoch > 1 ) && ( fabs( objective - previous_objective ) <= epsilon * max( 1.0, fabs( objective ) ) ) ){
+      break;
+    }
+    previous_objective = objective;
+  }
+
+  for( unsigned int i = 1; i < _llms.size(); i++ ){
+    _llms[ i ]->weights() = weights;
+  }
+  return;
+}
+
 void 
 LLM::
 to_xml( const string& filename )const{
@@ -383,6 +2118,7 @@ to_xml( xmlDocPtr doc,
   xmlNodePtr node = xmlNewDocNode( doc, NULL, ( const xmlChar* )( "llm" ), NULL );
   _feature_set->to_xml( doc, node );
   stringstream weights_string;
+  weights_string << setprecision( numeric_limits< double >::digits10 + 2 );
   for( unsigned int i = 0; i < _weights.size(); i++ ){
     weights_string << _weights[ i ];
     if( i != ( _weights.size() - 1 ) ){
@@ -417,52 +2153,405 @@ from_xml( const string& filename ){
   return;
 }
 
-void 
-LLM::
-from_xml( xmlNodePtr root ){
-  _weights.clear();
+void 
+LLM::
+from_xml( xmlNodePtr root ){
+  _weights.clear();
+
+  if( root->type == XML_ELEMENT_NODE ){
+    xmlChar * tmp = xmlGetProp( root, ( const xmlChar* )( "weights" ) );
+    if( tmp != NULL ){
+      string weights_string = ( char* )( tmp );
+      vector< string > weights_strings;
+      boost::split( weights_strings, weights_string, boost::is_any_of( "," ) );
+      _weights.resize( weights_strings.size() );
+      for( unsigned int i = 0; i < weights_strings.size(); i++ ){
+        _weights[ i ] = strtod( weights_strings[ i ].c_str(), NULL );
+      }
+      xmlFree( tmp );
+    }   
+    xmlNodePtr l1 = NULL;
+    for( l1 = root->children; l1; l1 = l1->next ){
+      if( l1->type == XML_ELEMENT_NODE ){
+        if( xmlStrcmp( l1->name, ( const xmlChar* )( "feature_set" ) ) == 0 ){
+          _feature_set->from_xml( l1 );
+        }
+      }
+    }  
+  }
+  _weights.resize( _feature_set->size() );
+  return;
+}
+
+/**
+ * the header of the binary model format. the serialized feature set follows the header and the 
+ * weights are stored as native doubles at weights_offset, which is aligned so that the file can be mapped;
+ * the header holds a CRC-32 of the serialized feature set and one of the weights
+ */
+typedef struct {
+  char magic[ 8 ];
+  unsigned int version;
+  unsigned int byte_order;
+  unsigned int feature_set_checksum;
+  unsigned int weights_checksum;
+  unsigned long long num_weights;
+  unsigned long long feature_set_offset;
+  unsigned long long feature_set_size;
+  unsigned long long weights_offset;
+} llm_binary_header_t;
+
+static const char LLM_BINARY_MAGIC[ 8 ] = { 'H', '2', 'S', 'L', 'L', 'L', 'M', '1' };
+static const unsigned int LLM_BINARY_VERSION = 2;
+static const unsigned int LLM_BINARY_BYTE_ORDER = 0x01020304;
+
+bool
+LLM::
+to_binary( const string& filename )const{
+  xmlDocPtr doc = xmlNewDoc( ( xmlChar* )( "1.0" ) );
+  xmlNodePtr root = xmlNewDocNode( doc, NULL, ( xmlChar* )( "root" ), NULL );
+  xmlDocSetRootElement( doc, root );
+  _feature_set->to_xml( doc, root );
+  xmlChar * feature_set_buffer = NULL;
+  int feature_set_size = 0;
+  xmlDocDumpMemory( doc, &feature_set_buffer, &feature_set_size );
+  xmlFreeDoc( doc );
+
+  llm_binary_header_t header;
+  memset( &header, 0, sizeof( header ) );
+  memcpy( header.magic, LLM_BINARY_MAGIC, sizeof( header.magic ) );
+  header.version = LLM_BINARY_VERSION;
+  header.byte_order = LLM_BINARY_BYTE_ORDER;
+  header.feature_set_checksum = _feature_set->checksum();
+  boost::crc_32_type crc;
+  crc.process_bytes( _weights.data(), _weights.size() * sizeof( double ) );
+  header.weights_checksum = crc.checksum();
+  header.num_weights = _weights.size();
+  header.feature_set_offset = sizeof( header );
+  header.feature_set_size = feature_set_size;
+  header.weights_offset = ( ( header.feature_set_offset + header.feature_set_size + sizeof( double ) - 1 ) / sizeof( double ) ) * sizeof( double );
+
+  ofstream out( filename.c_str(), ios::out | ios::binary | ios::trunc );
+  if( out.is_open() ){
+    const char padding[ sizeof( double ) ] = { 0 };
+    out.write( ( const char* )( &header ), sizeof( header ) );
+    out.write( ( const char* )( feature_set_buffer ), feature_set_size );
+    out.write( padding, header.weights_offset - header.feature_set_offset - header.feature_set_size );
+    out.write( ( const char* )( _weights.data() ), _weights.size() * sizeof( double ) );
+    out.close();
+  }
+  xmlFree( feature_set_buffer );
+  return !out.fail();
+}
+
+/**
+ * maps a model written by to_binary, reads its feature set and copies the weights out of the mapping
+ */
+bool
+LLM::
+from_binary( const string& filename ){
+  try {
+    boost::interprocess::file_mapping file( filename.c_str(), boost::interprocess::read_only );
+    boost::interprocess::mapped_region region( file, boost::interprocess::read_only );
+    const char * data = ( const char* )( region.get_address() );
+    const llm_binary_header_t * header = ( const llm_binary_header_t* )( data );
+
+    if( ( region.get_size() < sizeof( llm_binary_header_t ) ) || ( memcmp( header->magic, LLM_BINARY_MAGIC, sizeof( header->magic ) ) != 0 ) ){
+      cout << filename << " is truncated or is not a binary llm" << endl;
+      return false;
+    }
+    if( ( header->version != LLM_BINARY_VERSION ) || ( header->byte_order != LLM_BINARY_BYTE_ORDER ) ){
+      cout << filename << " was written by an incompatible version or byte order" << endl;
+      return false;
+    }
+    if( ( header->feature_set_offset + header->feature_set_size > region.get_size() ) || ( header->weights_offset + header->num_weights * sizeof( double ) > region.get_size() ) ){
+      cout << filename << " is truncated" << endl;
+      return false;
+    }
+
+    xmlDoc * doc = xmlReadMemory( data + header->feature_set_offset, header->feature_set_size, filename.c_str(), NULL, 0 );
+    if( doc == NULL ){
+      cout << "could not read the feature set of " << filename << endl;
+      return false;
+    }
+    xmlNodePtr root = xmlDocGetRootElement( doc );
+    for( xmlNodePtr l1 = root->children; l1; l1 = l1->next ){
+      if( ( l1->type == XML_ELEMENT_NODE ) && ( xmlStrcmp( l1->name, ( const xmlChar* )( "feature_set" ) ) == 0 ) ){
+        _feature_set->from_xml( l1 );
+      }
+    }
+    xmlFreeDoc( doc );
+
+    if( _feature_set->checksum() != header->feature_set_checksum ){
+      cout << "the feature set of " << filename << " does not match its checksum" << endl;
+      return false;
+    }
+    if( header->num_weights != _feature_set->size() ){
+      cout << filename << " has " << header->num_weights << " weights for a feature set of size " << _feature_set->size() << endl;
+      return false;
+    }
+
+    const double * weights = ( const double* )( data + header->weights_offset );
+    boost::crc_32_type crc;
+    crc.process_bytes( weights, header->num_weights * sizeof( double ) );
+    if( crc.checksum() != header->weights_checksum ){
+      cout << "the weights of " << filename << " do not match their checksum" << endl;
+      return false;
+    }
+    _weights.assign( weights, weights + header->num_weights );
+  } catch( const boost::interprocess::interprocess_exception& e ){
+    cout << "could not map " << filename << " (" << e.what() << ")" << endl;
+    return false;
+  }
+  return true;
+}
+
+bool
+LLM::
+is_binary( const string& filename ){
+  ifstream in( filename.c_str(), ios::in | ios::binary );
+  char magic[ sizeof( LLM_BINARY_MAGIC ) ];
+  in.read( magic, sizeof( magic ) );
+  return in.good() && ( memcmp( magic, LLM_BINARY_MAGIC, sizeof( magic ) ) == 0 );
+}
+
+/**
+ * zeros the weights whose magnitude is at most threshold and returns the number of weights that were zeroed
+ */
+unsigned int
+LLM::
+prune( const double& threshold ){
+  unsigned int num_pruned = 0;
+  for( unsigned int i = 0; i < _weights.size(); i++ ){
+    if( ( _weights[ i ] != 0.0 ) && ( fabs( _weights[ i ] ) <= threshold ) ){
+      _weights[ i ] = 0.0;
+      num_pruned++;
+    }
+  }
+  return num_pruned;
+}
+
+/**
+ * reads a model in either the binary or the xml format, returns false
+ * when the file could not be read or holds no weights
+ */
+bool
+LLM::
+from_file( const string& filename ){
+  if( is_binary( filename ) ){
+    return from_binary( filename );
+  }
+  _weights.clear();
+  from_xml( filename );
+  return !_weights.empty();
+}
+
+namespace h2sl {
+  ostream&
+  operator<<( ostream& out,
+              const LLM& other ) {
+    return out;
+  }
+}
+
+LLM_Holdout::
+LLM_Holdout( const LLM_Index_Table& indices,
+              const vector< LLM_Index_Map_Cell >& cells,
+              const vector< pair< unsigned int, unsigned int > >& ranges,
+              const unsigned int& patience ) : _indices( &indices ),
+                                                _cells( &cells ),
+                                                _ranges( ranges ),
+                                                _patience( patience ),
+                                                _llm(),
+                                                _pending(),
+                                                _results(),
+                                                _best_weights(),
+                                                _best( 0 ),
+                                                _busy( false ),
+                                                _shutdown( false ),
+                                                _mutex(),
+                                                _pending_condition(),
+                                                _idle_condition(),
+                                                _thread( NULL ) {
+  _thread = new boost::thread( &LLM_Holdout::_worker, this );
+}
+
+LLM_Holdout::
+~LLM_Holdout() {
+  {
+    boost::mutex::scoped_lock lock( _mutex );
+    _shutdown = true;
+  }
+  _pending_condition.notify_all();
+
+  if( _thread != NULL ){
+    _thread->join();
+    delete _thread;
+    _thread = NULL;
+  }
+}
+
+/**
+ * queues a copy of the weights after the given iteration for evaluation without waiting for it
+ */
+void
+LLM_Holdout::
+submit( const unsigned int& iteration,
+        const double* weights,
+        const unsigned int& size ){
+  {
+    boost::mutex::scoped_lock lock( _mutex );
+    _pending.push_back( pair< unsigned int, vector< double > >( iteration, vector< double >( weights, weights + size ) ) );
+  }
+  _pending_condition.notify_one();
+  return;
+}
+
+/**
+ * blocks until every submitted snapshot has been evaluated
+ */
+void
+LLM_Holdout::
+finish( void ){
+  boost::mutex::scoped_lock lock( _mutex );
+  while( _busy || !_pending.empty() ){
+    _idle_condition.wait( lock );
+  }
+  return;
+}
 
-  if( root->type == XML_ELEMENT_NODE ){
-    xmlChar * tmp = xmlGetProp( root, ( const xmlChar* )( "weights" ) );
-    if( tmp != NULL ){
-      string weights_string = ( char* )( tmp );
-      vector< string > weights_strings;
-      boost::split( weights_strings, weights_string, boost::is_any_of( "," ) );
-      _weights.resize( weights_strings.size() );
-      for( unsigned int i = 0; i < weights_strings.size(); i++ ){
-        _weights[ i ] = strtof( weights_strings[ i ].c_str(), NULL );
+/**
+ * checks if the last patience evaluations all failed to improve on the best held-out log-likelihood
+ */
+bool
+LLM_Holdout::
+plateaued( void ){
+  boost::mutex::scoped_lock lock( _mutex );
+  return !_results.empty() && ( _results.size() - 1 - _best >= _patience );
+}
+
+void
+LLM_Holdout::
+_worker( void ){
+  while( true ){
+    unsigned int iteration = 0;
+    {
+      boost::mutex::scoped_lock lock( _mutex );
+      while( !_shutdown && _pending.empty() ){
+        _pending_condition.wait( lock );
       }
-      xmlFree( tmp );
-    }   
-    xmlNodePtr l1 = NULL;
-    for( l1 = root->children; l1; l1 = l1->next ){
-      if( l1->type == XML_ELEMENT_NODE ){
-        if( xmlStrcmp( l1->name, ( const xmlChar* )( "feature_set" ) ) == 0 ){
-          _feature_set->from_xml( l1 );
-        }
+      if( _shutdown ){
+        return;
       }
-    }  
+      iteration = _pending.front().first;
+      _llm.weights().swap( _pending.front().second );
+      _pending.pop_front();
+      _busy = true;
+    }
+
+    llm_holdout_result_t result = _evaluate( iteration );
+
+    {
+      boost::mutex::scoped_lock lock( _mutex );
+      _results.push_back( result );
+      if( ( _results.size() == 1 ) || ( result.objective > _results[ _best ].objective ) ){
+        _best = _results.size() - 1;
+        _best_weights = _llm.weights();
+      }
+      _busy = false;
+    }
+    _idle_condition.notify_all();
   }
-  _weights.resize( _feature_set->size() );
-  return;
 }
 
-namespace h2sl {
-  ostream&
-  operator<<( ostream& out,
-              const LLM& other ) {
-    return out;
+/**
+ * computes the log-likelihood and the number of correctly labeled examples of the held-out rows
+ */
+llm_holdout_result_t
+LLM_Holdout::
+_evaluate( const unsigned int& iteration ){
+  llm_holdout_result_t result;
+  result.iteration = iteration;
+  result.objective = 0.0;
+  result.num_correct = 0.0;
+
+  vector< double > log_pygxs;
+  for( unsigned int r = 0; r < _ranges.size(); r++ ){
+    for( unsigned int batch = _ranges[ r ].first; batch < _ranges[ r ].second; batch += 256 ){
+      const unsigned int batch_end = min( _ranges[ r ].second, batch + 256 );
+      _llm.log_pygx( *_indices, batch, batch_end, log_pygxs );
+      const double * log_pygx = log_pygxs.data();
+      for( unsigned int i = batch; i < batch_end; i++ ){
+        const LLM_Index_Map_Cell& cell = (*_cells)[ i ];
+        const unsigned int num_cvs = _indices->num_cvs( i );
+        double numerator = 0.0;
+        unsigned int best = 0;
+        for( unsigned int k = 0; k < num_cvs; k++ ){
+          if( cell.is_label( k ) ){
+            numerator += exp( log_pygx[ k ] );
+          }
+          if( log_pygx[ k ] > log_pygx[ best ] ){
+            best = k;
+          }
+        }
+        if( numerator > 0.0 ){
+          result.objective += cell.weight() * log( numerator );
+        }
+        if( ( num_cvs > 0 ) && cell.is_label( best ) ){
+          result.num_correct += cell.weight();
+        }
+        log_pygx += _indices->num_cvs( i );
+      }
+    }
   }
+  return result;
 }
 
 LLM_Train::
-LLM_Train( const vector< LLM* >& llms,
-            vector< pair< unsigned int, LLM_X > >* examples ) : _llms( llms ),
-                                                                _examples( examples ),
-//                                                                _index_map(),
-                                                                _index_vector(),
-                                                                _gradient(),
-                                                                _indices() {
+LLM_Train( const vector< LLM* >& llms ) : _llms( llms ),
+                                          _cells(),
+                                          _cv_sets(),
+                                          _num_examples( 0 ),
+                                          _num_groups( 0 ),
+                                          _cached( false ),
+                                          _index_seconds( 0.0 ),
+                                          _index_busy(),
+                                          _shards(),
+                                          _gradient(),
+                                          _shard_gradients(),
+                                          _thread_gradients(),
+                                          _thread_scores(),
+                                          _shard_touched(),
+                                          _indices( new LLM_Index_Table() ),
+                                          _features(),
+                                          _chunk_size( 256 ),
+                                          _optimizer( LLM_TRAIN_OPTIMIZER_LBFGS ),
+                                          _batch_size( 64 ),
+                                          _learning_rate( 0.1 ),
+                                          _lambda( 0.001 ),
+                                          _l1( 0.0 ),
+                                          _verbose( true ),
+                                          _deduplicate( false ),
+                                          _deterministic( false ),
+                                          _negatives( 0 ),
+                                          _hard_negatives( false ),
+                                          _row_ranges(),
+                                          _holdout_ranges(),
+                                          _patience( 5 ),
+                                          _holdout_interval( 1 ),
+                                          _holdout( NULL ),
+                                          _final_objective( 0.0 ),
+                                          _telemetry( NULL ),
+                                          _process_group( NULL ),
+                                          _num_evaluations( 0 ),
+                                          _job_seconds(),
+                                          _seed( 0 ),
+                                          _prior(),
+                                          _prior_lambda( 0.0 ),
+                                          _index_cache(),
+                                          _index_cache_key(),
+                                          _out_of_core(),
+                                          _index_writer(),
+                                          _thread_pool( NULL ) {
   if( !_llms.empty() ){
     _gradient.resize( _llms.front()->weights().size() );
   }
@@ -470,13 +2559,61 @@ LLM_Train( const vector< LLM* >& llms,
 
 LLM_Train::
 ~LLM_Train(){
-  
+  if( _holdout != NULL ){
+    delete _holdout;
+    _holdout = NULL;
+  }
+  if( _thread_pool != NULL ){
+    delete _thread_pool;
+    _thread_pool = NULL;
+  }
 }
 
 LLM_Train::
 LLM_Train( const LLM_Train& other ) : _llms( other._llms ),
-                                      _examples( other._examples ),
-                                      _indices( other._indices ){
+                                      _cells( other._cells ),
+                                      _cv_sets( other._cv_sets ),
+                                      _num_examples( other._num_examples ),
+                                      _num_groups( other._num_groups ),
+                                      _cached( other._cached ),
+                                      _index_seconds( other._index_seconds ),
+                                      _index_busy( other._index_busy ),
+                                      _shards( other._shards ),
+                                      _gradient( other._gradient ),
+                                      _shard_gradients( other._shard_gradients ),
+                                      _thread_gradients( other._thread_gradients ),
+                                      _thread_scores( other._thread_scores ),
+                                      _shard_touched( other._shard_touched ),
+                                      _indices( other._indices ),
+                                      _chunk_size( other._chunk_size ),
+                                      _optimizer( other._optimizer ),
+                                      _batch_size( other._batch_size ),
+                                      _learning_rate( other._learning_rate ),
+                                      _lambda( other._lambda ),
+                                      _l1( other._l1 ),
+                                      _verbose( other._verbose ),
+                                      _deduplicate( other._deduplicate ),
+                                      _deterministic( other._deterministic ),
+                                      _negatives( other._negatives ),
+                                      _hard_negatives( other._hard_negatives ),
+                                      _row_ranges( other._row_ranges ),
+                                      _holdout_ranges( other._holdout_ranges ),
+                                      _patience( other._patience ),
+                                      _holdout_interval( other._holdout_interval ),
+                                      _holdout( NULL ),
+                                      _final_objective( other._final_objective ),
+                                      _telemetry( other._telemetry ),
+                                      _process_group( NULL ),
+                                      _num_evaluations( other._num_evaluations ),
+                                      _job_seconds(),
+                                      _seed( other._seed ),
+                                      _prior( other._prior ),
+                                      _prior_lambda( other._prior_lambda ),
+                                      _index_cache( other._index_cache ),
+                                      _index_cache_key( other._index_cache_key ),
+                                      _out_of_core( other._out_of_core ),
+                                      _index_writer( other._index_writer ),
+                                      _thread_pool( NULL ){
 
 }
     
@@ -484,20 +2621,94 @@ LLM_Train&
 LLM_Train::
 operator=( const LLM_Train& other ){
   _llms = other._llms;
-  _examples = other._examples;
+  _cells = other._cells;
+  _cv_sets = other._cv_sets;
+  _num_examples = other._num_examples;
+  _num_groups = other._num_groups;
+  _cached = other._cached;
+  _index_seconds = other._index_seconds;
+  _index_busy = other._index_busy;
+  _shards = other._shards;
+  _gradient = other._gradient;
+  _shard_gradients = other._shard_gradients;
+  _thread_gradients = other._thread_gradients;
+  _thread_scores = other._thread_scores;
+  _shard_touched = other._shard_touched;
   _indices = other._indices;
+  _chunk_size = other._chunk_size;
+  _optimizer = other._optimizer;
+  _batch_size = other._batch_size;
+  _learning_rate = other._learning_rate;
+  _lambda = other._lambda;
+  _l1 = other._l1;
+  _verbose = other._verbose;
+  _deduplicate = other._deduplicate;
+  _deterministic = other._deterministic;
+  _negatives = other._negatives;
+  _hard_negatives = other._hard_negatives;
+  _row_ranges = other._row_ranges;
+  _holdout_ranges = other._holdout_ranges;
+  _patience = other._patience;
+  _holdout_interval = other._holdout_interval;
+  _final_objective = other._final_objective;
+  _telemetry = other._telemetry;
+  _num_evaluations = other._num_evaluations;
+  _seed = other._seed;
+  _prior = other._prior;
+  _prior_lambda = other._prior_lambda;
+  _index_cache = other._index_cache;
+  _index_cache_key = other._index_cache_key;
+  _out_of_core = other._out_of_core;
+  _index_writer = other._index_writer;
   return (*this);
 }
 
+/**
+ * computes the log-likelihood and its gradient in a single pass, evaluating the softmax once per example
+ */
 void
 LLM_Train::
-compute_objective_thread( vector< LLM_Index_Map_Cell >& cells, LLM* llm, double& objective ){
+compute_objective_and_gradient_thread( const LLM_Index_Map_Shard& shard, const LLM_Index_Table& indices, LLM* llm, double& objective, vector< double >& gradient, vector< double >& scores ){
+  const unsigned int batch_size = 256;
   objective = 0.0;
-  for( unsigned int i = 0; i < cells.size(); i++ ){
-    for( unsigned int k = 0; k < cells[ i ].llm_x().cvs().size(); k++ ){
-      if( cells[ i ].cv() == cells[ i ].llm_x().cvs()[ k ] ){
-        objective += log( llm->pygx( cells[ i ].cv(), cells[ i ].llm_x(), cells[ i ].llm_x().cvs(), cells[ i ].indices() ) );
-      }
+  for( unsigned int batch = 0; batch < shard.size(); batch += batch_size ){
+    const unsigned int batch_end = min( shard.size(), batch + batch_size );
+    indices.prefetch( shard.begin() + batch_end, shard.begin() + min( shard.size(), batch_end + batch_size ) );
+    llm->log_pygx( indices, shard.begin() + batch, shard.begin() + batch_end, scores );
+
+    const double * log_pygx = scores.data();
+    for( unsigned int i = batch; i < batch_end; i++ ){
+      const LLM_Index_Map_Cell& cell = shard[ i ];
+      const unsigned int row = shard.begin() + i;
+
+      accumulate_example( cell, indices, row, log_pygx, objective, gradient );
+      log_pygx += indices.num_cvs( row );
+    }
+  }
+  return;
+}
+
+/**
+ * pulls shards off the shared queue and evaluates each into the dense gradient of this thread, 
+ * then moves the entries the shard touched into its own buffer and clears them
+ */
+void
+LLM_Train::
+compute_objective_and_gradient_worker( const vector< LLM_Index_Map_Shard >& shards,
+                                        const vector< vector< unsigned int > >& touched,
+                                        const LLM_Index_Table& indices,
+                                        LLM* llm,
+                                        Work_Queue& queue,
+                                        vector< double >& objectives,
+                                        vector< double >& gradient,
+                                        vector< double >& scores,
+                                        vector< vector< double > >& shardGradients ){
+  unsigned int shard = 0;
+  while( queue.next( shard ) ){
+    compute_objective_and_gradient_thread( shards[ shard ], indices, llm, objectives[ shard ], gradient, scores );
+    for( unsigned int j = 0; j < touched[ shard ].size(); j++ ){
+      shardGradients[ shard ][ j ] = gradient[ touched[ shard ][ j ] ];
+      gradient[ touched[ shard ][ j ] ] = 0.0;
     }
   }
   return;
@@ -505,180 +2716,595 @@ compute_objective_thread( vector< LLM_Index_Map_Cell >& cells, LLM* llm, double&
 
 double
 LLM_Train::
-objective( const vector< pair< unsigned int, LLM_X > >& examples,
-            const vector< vector< vector< unsigned int > > >& indices,
-            double lambda ){
-  double objective = 0.0;
+objective_and_gradient( double lambda ){
+  struct timeval start_time;
+  gettimeofday( &start_time, NULL );
+  _num_evaluations++;
+
+  // the workers evaluate their examples while this process evaluates its own
+  if( ( _process_group != NULL ) && _process_group->is_coordinator() ){
+    _process_group->broadcast( _llms.front()->weights() );
+  }
 
-//  map< const h2sl::World*, vector< LLM_Index_Map_Cell > >::iterator it = _index_map.begin();
-  vector< vector< LLM_Index_Map_Cell > >::iterator it = _index_vector.begin();
-//  while( it != _index_map.end() ){
-  while( it != _index_vector.end() ){
-    vector< boost::thread > threads;
-    vector< double > objectives( _llms.size(), 0.0 );
-    for( unsigned int i = 0; i < _llms.size(); i++ ){
-//      if( it != _index_map.end() ){
-      if( it != _index_vector.end() ){
-//        threads.push_back( boost::thread( LLM_Train::compute_objective_thread, it->second, _llms[ i ], boost::ref( objectives[ i ] ) ) );
-        threads.push_back( boost::thread( LLM_Train::compute_objective_thread, *it, _llms[ i ], boost::ref( objectives[ i ] ) ) );
-        it++;
-      }
-    }
-   
-    for( unsigned int i = 0; i < threads.size(); i++ ){
-      threads[ i ].join();
-    }
+  double objective = _data_objective_and_gradient();
 
-    for( unsigned int i = 0; i < objectives.size(); i++ ){
-      objective += objectives[ i ];
-    }   
+  if( ( _process_group != NULL ) && _process_group->is_coordinator() ){
+    _process_group->reduce( objective, _gradient );
   }
 
   double half_lambda = lambda / 2.0;
+  double half_prior_lambda = _prior_lambda / 2.0;
   for( unsigned int i = 0; i < _llms.front()->weights().size(); i++ ){
-    objective -= half_lambda * _llms.front()->weights()[ i ] * _llms.front()->weights()[ i ];
+    const double& weight = _llms.front()->weights()[ i ];
+    double offset = _prior.empty() ? 0.0 : weight - _prior[ i ];
+    objective -= half_lambda * weight * weight + half_prior_lambda * offset * offset;
+    _gradient[ i ] -= lambda * weight + _prior_lambda * offset;
+  }
+
+  if( _telemetry != NULL ){
+    struct timeval end_time;
+    gettimeofday( &end_time, NULL );
+    _telemetry->write( "evaluation", Telemetry_Record().add( "evaluation", _num_evaluations ).add( "objective", objective ).add( "seconds", diff_time( start_time, end_time ) ).add( "busy", _job_seconds ) );
   }
+
   return objective;
 }
 
+/**
+ * waits for weights from the coordinator of the process group and answers with the unregularized 
+ * objective and gradient of this process' examples until the coordinator stops the group; when the 
+ * coordinator finishes the group instead, the models are left with the trained weights
+ */
 void
 LLM_Train::
-compute_gradient_thread( vector< LLM_Index_Map_Cell >& cells, LLM* llm, std::vector< double >& gradient ){
-  for( unsigned int i = 0; i < cells.size(); i++ ){
-    for( unsigned int k = 0; k < cells[ i ].llm_x().cvs().size(); k++ ){
-      double tmp = llm->pygx( cells[ i ].llm_x().cvs()[ k ], cells[ i ].llm_x(), cells[ i ].llm_x().cvs(), cells[ i ].indices() );
-      for( unsigned int l = 0; l < cells[ i ].indices()[ k ].size(); l++ ){
-        gradient[ cells[ i ].indices()[ k ][ l ] ] -= tmp;
-      }
-      if( cells[ i ].cv() == cells[ i ].llm_x().cvs()[ k ] ){
-        for( unsigned int l = 0; l < cells[ i ].indices()[ k ].size(); l++ ){
-          gradient[ cells[ i ].indices()[ k ][ l ] ] += 1.0;
-        }
-      }
+serve( void ){
+  if( _process_group == NULL ){
+    return;
+  }
+
+  vector< double > weights;
+  while( _process_group->receive( weights ) ){
+    for( unsigned int i = 0; i < _llms.size(); i++ ){
+      _llms[ i ]->weights() = weights;
+    }
+    _gradient.resize( weights.size() );
+    double objective = _data_objective_and_gradient();
+    _process_group->send( objective, _gradient );
+  }
+  if( _process_group->finished() ){
+    for( unsigned int i = 0; i < _llms.size(); i++ ){
+      _llms[ i ]->weights() = weights;
     }
   }
   return;
 }
 
-void
+/**
+ * sets _gradient to the gradient of the log-likelihood of the training rows and returns the log-likelihood
+ */
+double
 LLM_Train::
-gradient( double lambda ){
+_data_objective_and_gradient( void ){
+  double objective = 0.0;
   for( unsigned int i = 0; i < _gradient.size(); i++ ){
     _gradient[ i ] = 0.0;
   }
 
-  vector< vector< LLM_Index_Map_Cell > >::iterator it = _index_vector.begin();
-  while( it != _index_vector.end() ){
-    vector< boost::thread > threads;
-    vector< vector< double > > gradients( _llms.size(), vector< double >( _llms.front()->weights().size(), 0.0 ) );
-    for( unsigned int i = 0; i < _llms.size(); i++ ){
-      if( it != _index_vector.end() ){
-        threads.push_back( boost::thread( LLM_Train::compute_gradient_thread, *it, _llms[ i ], boost::ref( gradients[ i ] ) ) );
-        it++;
-      }
-    }
-    
-    for( unsigned int i = 0; i < threads.size(); i++ ){
-      threads[ i ].join();
-    }
+  vector< LLM_Index_Map_Shard > shards;
+  for( unsigned int i = 0; i < _shards.size(); i++ ){
+    shards.push_back( _shard( i ) );
+  }
 
-    for( unsigned int i = 0; i < gradients.size(); i++ ){
-      assert( _gradient.size() == gradients[ i ].size() );
-      for( unsigned int j = 0; j < gradients[ i ].size(); j++ ){
-        _gradient[ j ] += gradients[ i ][ j ];
-      }
-    }     
+  // every thread pulls shards off the queue, but the shards are summed in their own order below
+  vector< boost::function< void( void ) > > jobs;
+  vector< double > objectives( _shards.size(), 0.0 );
+  Work_Queue queue( _shards.size() );
+  _thread_gradients.resize( _llms.size() );
+  _thread_scores.resize( _llms.size() );
+  for( unsigned int i = 0; i < _llms.size(); i++ ){
+    _thread_gradients[ i ].resize( _gradient.size(), 0.0 );
+    jobs.push_back( boost::bind( LLM_Train::compute_objective_and_gradient_worker, boost::cref( shards ), boost::cref( _shard_touched ), boost::cref( *_indices ), _llms[ i ], boost::ref( queue ), boost::ref( objectives ), boost::ref( _thread_gradients[ i ] ), boost::ref( _thread_scores[ i ] ), boost::ref( _shard_gradients ) ) );
   }
-  
-  for( unsigned int i = 0; i < _llms.front()->weights().size(); i++ ){
-    _gradient[ i ] -= lambda * _llms.front()->weights()[ i ];
+
+  _run_jobs( jobs );
+
+  for( unsigned int i = 0; i < objectives.size(); i++ ){
+    objective += objectives[ i ];
   }
 
+  _merge_shard_gradients();
+
+  return objective;
+}
+
+/**
+ * scores the rows rows[ begin ] ... rows[ end - 1 ] of a minibatch in one gather into scores and accumulates their gradient
+ */
+void
+LLM_Train::
+compute_minibatch_thread( const vector< unsigned int >& rows,
+                          const unsigned int& begin,
+                          const unsigned int& end,
+                          const vector< LLM_Index_Map_Cell >& cells,
+                          const LLM_Index_Table& indices,
+                          const LLM* llm,
+                          double& objective,
+                          LLM_Gradient_Buffer& gradient,
+                          vector< double >& scores ){
+  objective = 0.0;
+  llm->log_pygx( indices, rows, begin, end, scores );
+  const double * log_pygx = scores.data();
+  for( unsigned int i = begin; i < end; i++ ){
+    const LLM_Index_Map_Cell& cell = cells[ rows[ i ] ];
+    accumulate_example( cell, indices, rows[ i ], log_pygx, objective, gradient );
+    log_pygx += indices.num_cvs( rows[ i ] );
+  }
   return;
 }
 
 void
 LLM_Train::
-compute_indices_thread( vector< LLM_Index_Map_Cell >& cells, LLM* llm ){
+compute_indices_thread( const LLM_Example_Set& examples,
+                        const unsigned int& begin,
+                        const unsigned int& end,
+                        LLM_Index_Table& indices, 
+                        LLM* llm ){
   vector< bool > evaluate_feature_types( NUM_FEATURE_TYPES, true );
   const h2sl::Phrase * last_phrase = NULL;
+  vector< unsigned int > cv_indices;
+  // the examples of a phrase share their children, so they are only rebuilt when the offset changes
+  vector< pair< const Phrase*, vector< Grounding* > > > children;
+  unsigned int last_children = numeric_limits< unsigned int >::max();
+
+  indices.clear();
 
-  for( unsigned int i = 0; i < cells.size(); i++ ){
-    if( last_phrase != cells[ i ].llm_x().phrase() ){
+  for( unsigned int i = begin; i < end; i++ ){
+    const llm_example_t& example = examples[ i ];
+    const Phrase * phrase = examples.phrase( example.phrase );
+    if( last_phrase != phrase ){
       evaluate_feature_types[ FEATURE_TYPE_LANGUAGE ] = true;
     } else {
       evaluate_feature_types[ FEATURE_TYPE_LANGUAGE ] = false;
     }
-    last_phrase = cells[ i ].llm_x().phrase();
+    last_phrase = phrase;
+    if( ( example.children != last_children ) || ( example.num_children != children.size() ) ){
+      examples.children( example, children );
+      last_children = example.children;
+    }
 
-    for( unsigned int k = 0; k < cells[ i ].llm_x().cvs().size(); k++ ){
-      cells[ i ].indices().push_back( vector< unsigned int >() );
+    const vector< unsigned int >& cvs = examples.cvs( example.cvs );
+    indices.push_row();
+    for( unsigned int k = 0; k < cvs.size(); k++ ){
       vector< Feature* > features;
-      llm->feature_set()->indices( cells[ i ].llm_x().cvs()[ k ],
-                                              cells[ i ].llm_x().grounding(),
-                                              cells[ i ].llm_x().children(),
-                                              cells[ i ].llm_x().phrase(),
-                                              cells[ i ].llm_x().world(), 
-                                              cells[ i ].indices().back(), 
-                                              features,
-                                              evaluate_feature_types );
+      llm->feature_set()->indices( cvs[ k ],
+                                    examples.grounding( example.grounding ),
+                                    children,
+                                    phrase,
+                                    examples.world( example.world ), 
+                                    cv_indices, 
+                                    features,
+                                    evaluate_feature_types );
+      indices.push_cv( cv_indices );
+    }
+  }
+
+  return;
+}
+
+/**
+ * pulls chunks of the examples off the shared queue until it is empty
+ */
+void
+LLM_Train::
+compute_indices_worker( const LLM_Example_Set& examples, 
+                        const vector< pair< unsigned int, unsigned int > >& chunks, 
+                        vector< LLM_Index_Table >& indices,
+                        Work_Queue& queue,
+                        LLM* llm ){
+  unsigned int chunk = 0;
+  while( queue.next( chunk ) ){
+    compute_indices_thread( examples, chunks[ chunk ].first, chunks[ chunk ].second, indices[ chunk ], llm );
+  }
+  return;
+}
+
+/**
+ * splits the cell table into contiguous shards of roughly equal cost, where the cost of an 
+ * example is the number of correspondence variables plus the number of active indices; in 
+ * deterministic mode the number of shards depends only on the number of rows, so the shard 
+ * sums, which are always merged in shard order, do not change with the number of threads
+ */
+void
+LLM_Train::
+partition( const unsigned int& numShards ){
+  _shards.clear();
+
+  vector< pair< unsigned int, unsigned int > > ranges = _training_ranges();
+
+  double total_cost = 0.0;
+  unsigned int num_rows = 0;
+  for( unsigned int r = 0; r < ranges.size(); r++ ){
+    for( unsigned int i = ranges[ r ].first; i < ranges[ r ].second; i++ ){
+      total_cost += _indices->num_cvs( i ) + _indices->num_values( i );
+    }
+    num_rows += ranges[ r ].second - ranges[ r ].first;
+  }
+  const unsigned int num_shards = _deterministic ? max( 1u, ( num_rows + LLM_TRAIN_DETERMINISTIC_SHARD_ROWS - 1 ) / LLM_TRAIN_DETERMINISTIC_SHARD_ROWS ) : numShards;
+
+  // shards never span rows outside of the training ranges, so a range boundary also ends a shard
+  unsigned int num_cuts = 0;
+  double cost = 0.0;
+  for( unsigned int r = 0; r < ranges.size(); r++ ){
+    unsigned int begin = ranges[ r ].first;
+    for( unsigned int i = ranges[ r ].first; i < ranges[ r ].second; i++ ){
+      cost += _indices->num_cvs( i ) + _indices->num_values( i );
+      if( ( num_cuts + 1 < num_shards ) && ( cost >= total_cost * ( double )( num_cuts + 1 ) / ( double )( num_shards ) ) ){
+        _shards.push_back( pair< unsigned int, unsigned int >( begin, i + 1 ) );
+        begin = i + 1;
+        num_cuts++;
+      }
+    }
+    if( begin < ranges[ r ].second ){
+      _shards.push_back( pair< unsigned int, unsigned int >( begin, ranges[ r ].second ) );
+    }
+  }
+  if( _shards.empty() ){
+    _shards.push_back( pair< unsigned int, unsigned int >( 0, 0 ) );
+  }
+
+  // the indices a shard can touch never change during training, so they are collected once here 
+  // and each shard keeps the gradient of just those entries, which is merged in O(touched)
+  _thread_gradients.assign( _llms.size(), vector< double >( _gradient.size(), 0.0 ) );
+  _shard_gradients.assign( _shards.size(), vector< double >() );
+  _shard_touched.assign( _shards.size(), vector< unsigned int >() );
+  vector< bool > touched( _gradient.size(), false );
+  for( unsigned int i = 0; i < _shards.size(); i++ ){
+    const unsigned int* first = _indices->values() + _indices->cv_offsets()[ _indices->example_offsets()[ _shards[ i ].first ] ];
+    const unsigned int* last = _indices->values() + _indices->cv_offsets()[ _indices->example_offsets()[ _shards[ i ].second ] ];
+    for( const unsigned int* index = first; index != last; index++ ){
+      if( !touched[ *index ] ){
+        touched[ *index ] = true;
+        _shard_touched[ i ].push_back( *index );
+      }
+    }
+    for( unsigned int j = 0; j < _shard_touched[ i ].size(); j++ ){
+      touched[ _shard_touched[ i ][ j ] ] = false;
+    }
+    sort( _shard_touched[ i ].begin(), _shard_touched[ i ].end() );
+    _shard_gradients[ i ].assign( _shard_touched[ i ].size(), 0.0 );
+  }
+
+  if( _telemetry != NULL ){
+    vector< double > shard_examples;
+    vector< double > shard_touched;
+    for( unsigned int i = 0; i < _shards.size(); i++ ){
+      shard_examples.push_back( _shards[ i ].second - _shards[ i ].first );
+      shard_touched.push_back( _shard_touched[ i ].size() );
     }
+    _telemetry->write( "partition", Telemetry_Record().add( "shards", _shards.size() ).add( "examples", shard_examples ).add( "touched", shard_touched ) );
   }
 
+  if( _verbose && _deterministic ){
+    cout << "split " << num_rows << " examples into " << _shards.size() << " deterministic shards" << endl;
+  } else if( _verbose ){
+    for( unsigned int i = 0; i < _shards.size(); i++ ){
+      cout << "shard " << i << " has " << _shards[ i ].second - _shards[ i ].first << " examples touching " << _shard_touched[ i ].size() << " weights" << endl;
+    }
+  }
+  return;
+}
+
+LLM_Index_Map_Shard
+LLM_Train::
+_shard( const unsigned int& index )const{
+  assert( index < _shards.size() );
+  return LLM_Index_Map_Shard( _cells, _shards[ index ].first, _shards[ index ].second );
+}
+
+/**
+ * adds the per-shard gradient buffers into _gradient in shard order
+ */
+void
+LLM_Train::
+_merge_shard_gradients( void ){
+  for( unsigned int i = 0; i < _shard_touched.size(); i++ ){
+    const vector< double >& shard_gradient = _shard_gradients[ i ];
+    const vector< unsigned int >& touched = _shard_touched[ i ];
+    for( unsigned int j = 0; j < touched.size(); j++ ){
+      _gradient[ touched[ j ] ] += shard_gradient[ j ];
+    }
+  }
   return;
 }
 
+/**
+ * hashes the correspondence variable, the labeled candidates, the candidate set and the index lists of a row
+ */
+inline size_t
+row_hash( const LLM_Index_Map_Cell& cell,
+          const LLM_Index_Table& indices,
+          const unsigned int& row ){
+  size_t hash = 0;
+  boost::hash_combine( hash, cell.cv() );
+  boost::hash_combine( hash, cell.labels() );
+  boost::hash_combine( hash, cell.cvs() );
+  for( unsigned int k = 0; k < indices.num_cvs( row ); k++ ){
+    boost::hash_combine( hash, indices.end( row, k ) - indices.begin( row, k ) );
+    boost::hash_range( hash, indices.begin( row, k ), indices.end( row, k ) );
+  }
+  return hash;
+}
+
+/**
+ * checks if two rows have the same correspondence variable, labeled candidates, candidate set and index lists
+ */
+inline bool
+same_row( const LLM_Index_Map_Cell& a,
+          const LLM_Index_Table& aIndices,
+          const unsigned int& aRow,
+          const LLM_Index_Map_Cell& b,
+          const LLM_Index_Table& bIndices,
+          const unsigned int& bRow ){
+  if( ( a.cv() != b.cv() ) || ( a.labels() != b.labels() ) || ( a.cvs() != b.cvs() ) || ( aIndices.num_cvs( aRow ) != bIndices.num_cvs( bRow ) ) ){
+    return false;
+  }
+  for( unsigned int k = 0; k < aIndices.num_cvs( aRow ); k++ ){
+    if( ( aIndices.end( aRow, k ) - aIndices.begin( aRow, k ) ) != ( bIndices.end( bRow, k ) - bIndices.begin( bRow, k ) ) ){
+      return false;
+    }
+    if( !equal( aIndices.begin( aRow, k ), aIndices.end( aRow, k ), bIndices.begin( bRow, k ) ) ){
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * collapses rows that are indistinguishable to the model into the first of them and weights its cell by 
+ * the number of copies, which leaves the objective and gradient unchanged while shrinking the table
+ */
 void
 LLM_Train::
-compute_indices( void ){
-  _indices.clear();
-  _indices.resize( _examples->size() );
-  _index_vector.clear();
-
-  vector< const h2sl::World* > world_vector;
-  for( unsigned int i = 0; i < _examples->size(); i++ ){
-    const LLM_X& example = (*_examples)[ i ].second;
-    bool new_world = true;
-    for( unsigned int j = 0; j < world_vector.size(); j++ ){
-      if( world_vector[ j ] == example.world() ){
-        new_world = false;
+_merge_duplicates( void ){
+  assert( _row_ranges.empty() && _holdout_ranges.empty() );
+  boost::shared_ptr< LLM_Index_Table > indices( new LLM_Index_Table() );
+  vector< LLM_Index_Map_Cell > cells;
+  boost::unordered_map< size_t, vector< unsigned int > > buckets;
+  vector< unsigned int > values;
+
+  for( unsigned int i = 0; i < _cells.size(); i++ ){
+    vector< unsigned int >& bucket = buckets[ row_hash( _cells[ i ], *_indices, i ) ];
+    unsigned int match = 0;
+    while( ( match < bucket.size() ) && !same_row( cells[ bucket[ match ] ], *indices, bucket[ match ], _cells[ i ], *_indices, i ) ){
+      match++;
+    }
+    if( match < bucket.size() ){
+      cells[ bucket[ match ] ].weight() += _cells[ i ].weight();
+    } else {
+      bucket.push_back( cells.size() );
+      cells.push_back( _cells[ i ] );
+      indices->push_row();
+      for( unsigned int k = 0; k < _indices->num_cvs( i ); k++ ){
+        values.assign( _indices->begin( i, k ), _indices->end( i, k ) );
+        indices->push_cv( values );
       }
-    }  
-    if( new_world ){
-      world_vector.push_back( example.world() );
     }
   }
 
-  map< const h2sl::World*, unsigned int > world_map;
-  for( unsigned int i = 0; i < world_vector.size(); i++ ){
-    world_map.insert( pair< const h2sl::World*, unsigned int >( world_vector[ i ], i % _llms.size() ) ); 
+  if( _verbose ){
+    cout << "merged " << _cells.size() << " examples into " << cells.size() << " unique rows" << endl;
   }
- 
-  _index_vector.resize( _llms.size() );
- 
-  for( unsigned int i = 0; i < _examples->size(); i++ ){
-    const unsigned int& cv = (*_examples)[ i ].first;
-    const LLM_X& example = (*_examples)[ i ].second;
-    map< const h2sl::World*, unsigned int >::iterator it = world_map.find( example.world() );
-    assert( it != world_map.end() );
-    _index_vector[ it->second ].push_back( LLM_Index_Map_Cell( i, cv, example, _indices[ i ] ) );
+
+  _cells.swap( cells );
+  _indices = indices;
+  return;
+}
+
+/**
+ * keeps about negatives() of the CV_FALSE training examples of every phrase and divides the weight of 
+ * each kept example by the probability that it was kept, so that the expected objective and gradient 
+ * are those of the full training set; examples are kept with probability proportional to one, or with 
+ * hard_negatives() to the probability that the current weights mislabel them
+ */
+void
+LLM_Train::
+_subsample_negatives( void ){
+  if( _negatives == 0 ){
+    return;
   }
 
-  vector< vector< LLM_Index_Map_Cell > >::iterator it = _index_vector.begin();
-  while( it != _index_vector.end() ){
-    vector< boost::thread > threads;
-    for( unsigned int i = 0; i < _llms.size(); i++ ){
-      if( it != _index_vector.end() ){
-        cout << "starting thread with " << (*it).size() << " examples" << endl;
-        threads.push_back( boost::thread( LLM_Train::compute_indices_thread, *it, _llms[ i ] ) );
-        it++;
+  vector< bool > training( _cells.size(), false );
+  vector< pair< unsigned int, unsigned int > > ranges = _training_ranges();
+  for( unsigned int r = 0; r < ranges.size(); r++ ){
+    for( unsigned int i = ranges[ r ].first; i < ranges[ r ].second; i++ ){
+      training[ i ] = true;
+    }
+  }
+
+  vector< vector< unsigned int > > groups( _num_groups );
+  for( unsigned int i = 0; i < _cells.size(); i++ ){
+    if( training[ i ] && ( _cells[ i ].cv() == CV_FALSE ) ){
+      groups[ _cells[ i ].group() ].push_back( i );
+    }
+  }
+
+  // with zero weights every candidate is equally likely, so every negative would be equally hard
+  const vector< double >& weights = _llms.front()->weights();
+  if( _hard_negatives && ( count( weights.begin(), weights.end(), 0.0 ) == ( int )( weights.size() ) ) ){
+    cout << "the starting weights are all zero, drawing the negatives uniformly instead of by hardness" << endl;
+  }
+
+  vector< double > hardness( _cells.size(), 1.0 );
+  if( _hard_negatives ){
+    vector< double > log_pygxs;
+    for( unsigned int batch = 0; batch < _cells.size(); batch += 256 ){
+      const unsigned int batch_end = min( ( unsigned int )( _cells.size() ), batch + 256 );
+      _llms.front()->log_pygx( *_indices, batch, batch_end, log_pygxs );
+      const double * log_pygx = log_pygxs.data();
+      for( unsigned int i = batch; i < batch_end; i++ ){
+        double pygx = 0.0;
+        for( unsigned int k = 0; k < _indices->num_cvs( i ); k++ ){
+          if( _cells[ i ].is_label( k ) ){
+            pygx += exp( log_pygx[ k ] );
+          }
+        }
+        // every negative keeps a nonzero probability of being drawn, otherwise the estimate is biased
+        hardness[ i ] = max( 1.0 - pygx, 1e-3 );
+        log_pygx += _indices->num_cvs( i );
+      }
+    }
+  }
+
+  boost::random::mt19937 generator( _seed );
+  boost::random::uniform_real_distribution< double > distribution( 0.0, 1.0 );
+  vector< bool > keep( _cells.size(), true );
+  unsigned int num_negatives = 0;
+  unsigned int num_kept = 0;
+  unsigned int num_phrases = 0;
+  for( unsigned int g = 0; g < groups.size(); g++ ){
+    if( groups[ g ].empty() ){
+      continue;
+    }
+    num_phrases++;
+    double total_hardness = 0.0;
+    for( unsigned int j = 0; j < groups[ g ].size(); j++ ){
+      total_hardness += hardness[ groups[ g ][ j ] ];
+    }
+    for( unsigned int j = 0; j < groups[ g ].size(); j++ ){
+      const unsigned int& row = groups[ g ][ j ];
+      const double probability = min( 1.0, ( double )( _negatives ) * hardness[ row ] / total_hardness );
+      if( distribution( generator ) < probability ){
+        _cells[ row ].weight() /= probability;
+        num_kept++;
+      } else {
+        keep[ row ] = false;
+      }
+      num_negatives++;
+    }
+  }
+
+  // the kept rows stay in order, so the training and held-out ranges only need to be shifted
+  boost::shared_ptr< LLM_Index_Table > indices( new LLM_Index_Table() );
+  vector< LLM_Index_Map_Cell > cells;
+  vector< unsigned int > new_rows( _cells.size() + 1, 0 );
+  vector< unsigned int > values;
+  for( unsigned int i = 0; i < _cells.size(); i++ ){
+    new_rows[ i ] = cells.size();
+    if( keep[ i ] ){
+      cells.push_back( _cells[ i ] );
+      indices->push_row();
+      for( unsigned int k = 0; k < _indices->num_cvs( i ); k++ ){
+        values.assign( _indices->begin( i, k ), _indices->end( i, k ) );
+        indices->push_cv( values );
       }
     }
+  }
+  new_rows[ _cells.size() ] = cells.size();
+  for( unsigned int i = 0; i < _row_ranges.size(); i++ ){
+    _row_ranges[ i ].first = new_rows[ min( _row_ranges[ i ].first, ( unsigned int )( _cells.size() ) ) ];
+    _row_ranges[ i ].second = new_rows[ min( _row_ranges[ i ].second, ( unsigned int )( _cells.size() ) ) ];
+  }
+  for( unsigned int i = 0; i < _holdout_ranges.size(); i++ ){
+    _holdout_ranges[ i ].first = new_rows[ min( _holdout_ranges[ i ].first, ( unsigned int )( _cells.size() ) ) ];
+    _holdout_ranges[ i ].second = new_rows[ min( _holdout_ranges[ i ].second, ( unsigned int )( _cells.size() ) ) ];
+  }
+
+  if( _verbose ){
+    cout << "kept " << num_kept << " of " << num_negatives << " negative examples from " << num_phrases << " phrases" << endl;
+  }
+  if( _telemetry != NULL ){
+    _telemetry->write( "subsample", Telemetry_Record().add( "phrases", num_phrases ).add( "negatives", num_negatives ).add( "kept", num_kept ).add( "hard", ( double )( _hard_negatives ) ) );
+  }
+
+  _cells.swap( cells );
+  _indices = indices;
+  return;
+}
+
+/**
+ * waits for the outstanding held-out evaluations and replaces the weights of every model with the 
+ * snapshot that had the highest held-out log-likelihood
+ */
+void
+LLM_Train::
+_restore_best_holdout_weights( void ){
+  _holdout->finish();
+
+  const vector< llm_holdout_result_t >& results = _holdout->results();
+  for( unsigned int i = 0; i < results.size(); i++ ){
+    if( _telemetry != NULL ){
+      _telemetry->write( "holdout", Telemetry_Record().add( "iteration", results[ i ].iteration ).add( "objective", results[ i ].objective ).add( "correct", results[ i ].num_correct ).add( "best", ( double )( i == _holdout->best() ) ) );
+    }
+  }
+  if( results.empty() ){
+    return;
+  }
+
+  const llm_holdout_result_t& best = results[ _holdout->best() ];
+  if( _verbose ){
+    cout << "evaluated " << results.size() << " snapshots on the held-out examples, keeping iteration " << best.iteration << " with log-likelihood " << best.objective << " (" << best.num_correct << " correct)" << endl;
+  }
+  for( unsigned int i = 0; i < _llms.size(); i++ ){
+    _llms[ i ]->weights() = _holdout->best_weights();
+  }
+  return;
+}
 
-    for( unsigned int i = 0; i < threads.size(); i++ ){
-      threads[ i ].join();
+/**
+ * returns the ranges of rows that training uses, which is every row unless row_ranges() was set
+ */
+vector< pair< unsigned int, unsigned int > >
+LLM_Train::
+_training_ranges( void )const{
+  vector< pair< unsigned int, unsigned int > > ranges;
+  if( _row_ranges.empty() ){
+    ranges.push_back( pair< unsigned int, unsigned int >( 0, _indices->num_rows() ) );
+  } else {
+    for( unsigned int i = 0; i < _row_ranges.size(); i++ ){
+      unsigned int begin = min( _row_ranges[ i ].first, _indices->num_rows() );
+      unsigned int end = min( _row_ranges[ i ].second, _indices->num_rows() );
+      if( begin < end ){
+        ranges.push_back( pair< unsigned int, unsigned int >( begin, end ) );
+      }
     }
   }
+  return ranges;
+}
+
+/**
+ * runs the jobs on the thread pool, which is started on first use with one thread per llm and kept 
+ * for the life of the trainer
+ */
+void
+LLM_Train::
+_run_jobs( const vector< boost::function< void( void ) > >& jobs ){
+  if( ( _thread_pool != NULL ) && ( _thread_pool->size() != _llms.size() ) ){
+    delete _thread_pool;
+    _thread_pool = NULL;
+  }
+  if( ( _thread_pool == NULL ) && ( _llms.size() > 1 ) ){
+    _thread_pool = new Thread_Pool( _llms.size() );
+  }
 
+  if( _telemetry != NULL ){
+    _job_seconds.assign( jobs.size(), 0.0 );
+    vector< boost::function< void( void ) > > timed_jobs;
+    for( unsigned int i = 0; i < jobs.size(); i++ ){
+      timed_jobs.push_back( boost::bind( run_timed_job, boost::cref( jobs[ i ] ), boost::ref( _job_seconds[ i ] ) ) );
+    }
+    if( _thread_pool != NULL ){
+      _thread_pool->run( timed_jobs );
+    } else {
+      for( unsigned int i = 0; i < timed_jobs.size(); i++ ){
+        timed_jobs[ i ]();
+      }
+    }
+  } else if( _thread_pool != NULL ){
+    _thread_pool->run( jobs );
+  } else {
+    for( unsigned int i = 0; i < jobs.size(); i++ ){
+      jobs[ i ]();
+    }
+  }
   return;
 }
@@ -0,0 +1,84 @@
+/**
+ * @file    llm_convert.cc
+ * @author  Thomas M. Howard (tmhoward@csail.mit.edu)
+ *          Matthew R. Walter (mwalter@csail.mit.edu)
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This file is part of h2sl.
+ *
+ * Copyright (C) 2014 by the Massachusetts Institute of Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/gpl-2.0.html> or write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * @section DESCRIPTION
+ *
+ * A program used to convert log-linear models between the xml and binary formats
+ */
+
+#include <iostream>
+
+#include "h2sl/llm.h"
+#include "llm_convert_cmdline.h"
+
+using namespace std;
+using namespace h2sl;
+
+int
+main( int argc,
+      char* argv[] ) {
+  gengetopt_args_info args;
+  if( cmdline_parser( argc, argv, &args ) != 0 ){
+    exit(1);
+  }
+
+  Feature_Set * feature_set = new Feature_Set();
+
+  LLM * llm = new LLM( feature_set );
+
+  cout << "reading llm from " << args.input_arg << endl;
+  int status = 0;
+  if( !llm->from_file( args.input_arg ) ){
+    cout << "could not read " << args.input_arg << endl;
+    status = 1;
+  } else {
+    cout << "read " << llm->weights().size() << " weights" << endl;
+    if( args.binary_flag ){
+      cout << "writing binary llm to " << args.output_arg << endl;
+      if( !llm->to_binary( args.output_arg ) ){
+        cout << "could not write " << args.output_arg << endl;
+        status = 1;
+      }
+    } else {
+      cout << "writing xml llm to " << args.output_arg << endl;
+      llm->to_xml( args.output_arg );
+    }
+  }
+
+  if( llm != NULL ){
+    delete llm;
+    llm = NULL;
+  }
+
+  if( feature_set != NULL ){
+    delete feature_set;
+    feature_set = NULL;
+  }
+
+  return status;
+}
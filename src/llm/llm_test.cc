@@ -0,0 +1,422 @@
+/**
+ * @file    llm_test.cc
+ * @author  Thomas M. Howard (tmhoward@csail.mit.edu)
+ *          Matthew R. Walter (mwalter@csail.mit.edu)
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This file is part of h2sl.
+ *
+ * Copyright (C) 2014 by the Massachusetts Institute of Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/gpl-2.0.html> or write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * @section DESCRIPTION
+ *
+ * A LLM class test program
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "h2sl/llm.h"
+#include "llm_test_cmdline.h"
+
+using namespace std;
+using namespace h2sl;
+
+/**
+ * byte offsets of the checksums in the header written by LLM::to_binary
+ */
+static const unsigned int FEATURE_SET_CHECKSUM_OFFSET = 16;
+static const unsigned int WEIGHTS_CHECKSUM_OFFSET = 20;
+
+/**
+ * reads a whole file into a string
+ */
+bool
+read_file( const string& filename,
+            string& contents ){
+  ifstream in( filename.c_str(), ios::in | ios::binary );
+  if( !in.is_open() ){
+    return false;
+  }
+  stringstream buffer;
+  buffer << in.rdbuf();
+  contents = buffer.str();
+  return true;
+}
+
+/**
+ * writes a string to a file
+ */
+bool
+write_file( const string& filename,
+            const string& contents ){
+  ofstream out( filename.c_str(), ios::out | ios::binary | ios::trunc );
+  out.write( contents.data(), contents.size() );
+  out.close();
+  return !out.fail();
+}
+
+/**
+ * fills the weights with values that do not survive a round trip through text, including signed zeros and extremes
+ */
+void
+fill_weights( vector< double >& weights ){
+  srand( 1 );
+  for( unsigned int i = 0; i < weights.size(); i++ ){
+    weights[ i ] = ( ( double )( rand() ) / ( double )( RAND_MAX ) - 0.5 ) * 1e3 / 3.0;
+  }
+  const double extremes[] = { -0.0, numeric_limits< double >::denorm_min(), numeric_limits< double >::max(), -numeric_limits< double >::min() };
+  for( unsigned int i = 0; ( i < 4 ) && ( i < weights.size() ); i++ ){
+    weights[ i ] = extremes[ i ];
+  }
+  return;
+}
+
+/**
+ * checks that a model written by to_binary is read back with a bitwise identical feature set and weights
+ */
+bool
+test_round_trip( const string& featureSetFilename,
+                  const string& filename ){
+  Feature_Set feature_set;
+  feature_set.from_xml( featureSetFilename );
+  LLM llm( &feature_set );
+  llm.weights().resize( feature_set.size() );
+  fill_weights( llm.weights() );
+
+  if( !llm.to_binary( filename ) ){
+    cout << "  could not write " << filename << endl;
+    return false;
+  }
+  if( !LLM::is_binary( filename ) || LLM::is_binary( featureSetFilename ) ){
+    cout << "  is_binary does not tell the binary and xml files apart" << endl;
+    return false;
+  }
+
+  Feature_Set other_feature_set;
+  LLM other( &other_feature_set );
+  if( !other.from_binary( filename ) ){
+    cout << "  could not read " << filename << endl;
+    return false;
+  }
+  if( ( other_feature_set.size() != feature_set.size() ) || ( other_feature_set.checksum() != feature_set.checksum() ) ){
+    cout << "  the feature set changed in the round trip" << endl;
+    return false;
+  }
+  if( ( other.weights().size() != llm.weights().size() ) || ( memcmp( other.weights().data(), llm.weights().data(), llm.weights().size() * sizeof( double ) ) != 0 ) ){
+    cout << "  the weights changed in the round trip" << endl;
+    return false;
+  }
+
+  Feature_Set file_feature_set;
+  LLM file_llm( &file_feature_set );
+  if( !file_llm.from_file( filename ) || ( file_llm.weights() != llm.weights() ) ){
+    cout << "  from_file did not read the binary model" << endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * checks that from_binary refuses a damaged copy of a good model
+ */
+bool
+test_rejects( const string& filename,
+              const string& contents,
+              const string& description ){
+  if( !write_file( filename, contents ) ){
+    cout << "  could not write " << filename << endl;
+    return false;
+  }
+
+  Feature_Set feature_set;
+  LLM llm( &feature_set );
+  if( llm.from_binary( filename ) ){
+    cout << "  read a model with " << description << endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * returns a copy of contents with the lowest bit of the byte at offset flipped
+ */
+string
+flip_bit( const string& contents,
+          const unsigned int& offset ){
+  string flipped = contents;
+  flipped[ offset ] ^= 0x01;
+  return flipped;
+}
+
+/**
+ * checks that LLM_Holdout scores snapshots on the held-out rows only, keeps the snapshot with the 
+ * highest held-out log-likelihood and reports a plateau after patience snapshots without improvement; 
+ * every row has two correspondence variables with one feature each and the held-out rows are labeled 
+ * with the second, so snapshot ( 0, s ) has the log-likelihood -log( 1 + exp( -s ) ) per held-out row
+ */
+bool
+test_holdout( void ){
+  LLM_Index_Table indices;
+  vector< LLM_Index_Map_Cell > cells;
+  for( unsigned int i = 0; i < 10; i++ ){
+    indices.push_row();
+    indices.push_cv( vector< unsigned int >( 1, 0 ) );
+    indices.push_cv( vector< unsigned int >( 1, 1 ) );
+    const bool held_out = ( i < 4 ) || ( ( i >= 6 ) && ( i < 8 ) );
+    cells.push_back( LLM_Index_Map_Cell( i, CV_TRUE, held_out ? 2 : 1, i, 1.0, 0 ) );
+  }
+  vector< pair< unsigned int, unsigned int > > ranges;
+  ranges.push_back( pair< unsigned int, unsigned int >( 0, 4 ) );
+  ranges.push_back( pair< unsigned int, unsigned int >( 6, 8 ) );
+
+  const double scales[ 6 ] = { 0.0, 1.0, 2.0, 1.5, 1.0, 3.0 };
+  LLM_Holdout holdout( indices, cells, ranges, 2 );
+  for( unsigned int i = 0; i < 5; i++ ){
+    const double weights[ 2 ] = { 0.0, scales[ i ] };
+    holdout.submit( 10 * i, weights, 2 );
+  }
+  holdout.finish();
+
+  if( holdout.results().size() != 5 ){
+    cout << "  evaluated " << holdout.results().size() << " of 5 snapshots" << endl;
+    return false;
+  }
+  for( unsigned int i = 0; i < holdout.results().size(); i++ ){
+    const llm_holdout_result_t& result = holdout.results()[ i ];
+    const double objective = -6.0 * log( 1.0 + exp( -scales[ i ] ) );
+    const double num_correct = ( scales[ i ] > 0.0 ) ? 6.0 : 0.0;
+    if( ( result.iteration != 10 * i ) || ( fabs( result.objective - objective ) > 1e-12 ) || ( result.num_correct != num_correct ) ){
+      cout << "  snapshot " << i << " scored " << result.objective << " with " << result.num_correct << " correct instead of " << objective << " with " << num_correct << " correct" << endl;
+      return false;
+    }
+  }
+  if( ( holdout.best() != 2 ) || ( holdout.best_weights().size() != 2 ) || ( holdout.best_weights()[ 1 ] != scales[ 2 ] ) ){
+    cout << "  kept snapshot " << holdout.best() << " instead of 2" << endl;
+    return false;
+  }
+  if( !holdout.plateaued() ){
+    cout << "  no plateau after two snapshots without improvement" << endl;
+    return false;
+  }
+
+  const double weights[ 2 ] = { 0.0, scales[ 5 ] };
+  holdout.submit( 50, weights, 2 );
+  holdout.finish();
+  if( ( holdout.best() != 5 ) || ( holdout.best_weights()[ 1 ] != scales[ 5 ] ) || holdout.plateaued() ){
+    cout << "  did not keep the improved snapshot " << holdout.best() << endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * checks that two index tables hold the same rows
+ */
+bool
+same_table( const LLM_Index_Table& table,
+            const LLM_Index_Table& expected ){
+  if( ( table.num_rows() != expected.num_rows() ) || ( table.num_cvs() != expected.num_cvs() ) || ( table.num_values() != expected.num_values() ) ){
+    cout << "  " << table.num_rows() << " rows with " << table.num_values() << " values instead of " << expected.num_rows() << " rows with " << expected.num_values() << " values" << endl;
+    return false;
+  }
+  if( ( memcmp( table.values(), expected.values(), expected.num_values() * sizeof( unsigned int ) ) != 0 ) ||
+      ( memcmp( table.cv_offsets(), expected.cv_offsets(), ( expected.num_cvs() + 1 ) * sizeof( unsigned long long ) ) != 0 ) ||
+      ( memcmp( table.example_offsets(), expected.example_offsets(), ( expected.num_rows() + 1 ) * sizeof( unsigned long long ) ) != 0 ) ){
+    cout << "  the rows differ" << endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * returns the number of shard files of one array written under prefix
+ */
+unsigned int
+num_shards( const string& prefix,
+            const unsigned int& array ){
+  struct stat status;
+  unsigned int shard = 0;
+  while( stat( LLM_Index_Table_Writer::filename( prefix, array, shard ).c_str(), &status ) == 0 ){
+    shard++;
+  }
+  return shard;
+}
+
+void
+remove_shards( const string& prefix ){
+  for( unsigned int array = 0; array < 3; array++ ){
+    const unsigned int shards = num_shards( prefix, array );
+    for( unsigned int shard = 0; shard < shards; shard++ ){
+      remove( LLM_Index_Table_Writer::filename( prefix, array, shard ).c_str() );
+    }
+  }
+  return;
+}
+
+/**
+ * checks that tables appended to shard files of shardSize bytes map back to the table built in 
+ * memory, and that an index cache of it maps and reads back only under its own key
+ */
+bool
+test_index_table( const string& prefix,
+                  const unsigned long long& shardSize,
+                  const bool& multipleShards ){
+  srand( 2 );
+  LLM_Index_Table table;
+  LLM_Index_Table_Writer writer;
+  if( !writer.open( prefix, shardSize ) ){
+    cout << "  could not open " << prefix << endl;
+    return false;
+  }
+  for( unsigned int i = 0; i < 20; i++ ){
+    LLM_Index_Table part;
+    const unsigned int num_rows = rand() % 500;
+    for( unsigned int j = 0; j < num_rows; j++ ){
+      part.push_row();
+      const unsigned int num_cvs = rand() % 4;
+      for( unsigned int k = 0; k < num_cvs; k++ ){
+        vector< unsigned int > indices( rand() % 7 );
+        for( unsigned int l = 0; l < indices.size(); l++ ){
+          indices[ l ] = rand();
+        }
+        part.push_cv( indices );
+      }
+    }
+    table.append( part );
+    if( !writer.append( part ) ){
+      cout << "  could not append to " << prefix << endl;
+      return false;
+    }
+  }
+  if( !writer.close() ){
+    cout << "  could not close " << prefix << endl;
+    return false;
+  }
+  if( multipleShards && ( num_shards( prefix, 0 ) < 2 ) ){
+    cout << "  wrote " << num_shards( prefix, 0 ) << " shards of values" << endl;
+    return false;
+  }
+
+  LLM_Index_Table mapped;
+  if( !mapped.map( prefix ) || !mapped.mapped() ){
+    cout << "  could not map " << prefix << endl;
+    return false;
+  }
+  mapped.prefetch( 0, mapped.num_rows() );
+  if( !same_table( mapped, table ) ){
+    return false;
+  }
+
+  const string cache = prefix + ".cache";
+  LLM_Index_Table cached;
+  LLM_Index_Table read;
+  LLM_Index_Table other;
+  bool passed = mapped.write( cache, "key" ) && cached.map( cache, "key" ) && same_table( cached, table ) && read.read( cache, "key" ) && same_table( read, table );
+  if( passed && other.map( cache, "other key" ) ){
+    cout << "  mapped " << cache << " under another key" << endl;
+    passed = false;
+  }
+  remove( cache.c_str() );
+  return passed;
+}
+
+int
+main( int argc,
+      char* argv[] ) {
+  int status = 0;
+  cout << "start of LLM class test program" << endl;
+
+  gengetopt_args_info args;
+  if( cmdline_parser( argc, argv, &args ) != 0 ){
+    exit(1);
+  }
+
+  const string filename = string( args.output_arg ) + ".llm";
+  const string corrupt_filename = string( args.output_arg ) + ".corrupt.llm";
+
+  cout << "writing and reading a binary model" << endl;
+  if( test_round_trip( args.feature_set_arg, filename ) ){
+    cout << "  passed" << endl;
+  } else {
+    cout << "  failed" << endl;
+    status = 1;
+  }
+
+  string contents;
+  if( !read_file( filename, contents ) || ( contents.size() <= WEIGHTS_CHECKSUM_OFFSET ) ){
+    cout << "could not read " << filename << endl;
+    exit(1);
+  }
+
+  cout << "reading corrupted binary models" << endl;
+  if( test_rejects( corrupt_filename, flip_bit( contents, 0 ), "a flipped bit in the magic" ) &&
+      test_rejects( corrupt_filename, flip_bit( contents, FEATURE_SET_CHECKSUM_OFFSET ), "a wrong feature set checksum" ) &&
+      test_rejects( corrupt_filename, flip_bit( contents, WEIGHTS_CHECKSUM_OFFSET ), "a wrong weights checksum" ) &&
+      test_rejects( corrupt_filename, flip_bit( contents, contents.size() - 1 ), "a flipped bit in the last weight" ) &&
+      test_rejects( corrupt_filename, contents.substr( 0, contents.size() - sizeof( double ) ), "a missing weight" ) &&
+      test_rejects( corrupt_filename, contents.substr( 0, WEIGHTS_CHECKSUM_OFFSET ), "only part of its header" ) ){
+    cout << "  passed" << endl;
+  } else {
+    cout << "  failed" << endl;
+    status = 1;
+  }
+
+  cout << "scoring snapshots on held-out rows" << endl;
+  if( test_holdout() ){
+    cout << "  passed" << endl;
+  } else {
+    cout << "  failed" << endl;
+    status = 1;
+  }
+
+  cout << "mapping an index table written to many shards" << endl;
+  if( test_index_table( args.output_arg, sysconf( _SC_PAGESIZE ), true ) ){
+    cout << "  passed" << endl;
+  } else {
+    cout << "  failed" << endl;
+    status = 1;
+  }
+  remove_shards( args.output_arg );
+
+  cout << "mapping an index table written to one shard" << endl;
+  if( test_index_table( args.output_arg, LLM_INDEX_TABLE_SHARD_SIZE, false ) ){
+    cout << "  passed" << endl;
+  } else {
+    cout << "  failed" << endl;
+    status = 1;
+  }
+  remove_shards( args.output_arg );
+
+  remove( filename.c_str() );
+  remove( corrupt_filename.c_str() );
+
+  cout << "end of LLM class test program" << endl;
+  return status;
+}
@@ -0,0 +1,319 @@
+/**
+ * @file    process_group.cc
+ * @author  Thomas M. Howard (tmhoward@csail.mit.edu)
+ *          Matthew R. Walter (mwalter@csail.mit.edu)
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This file is part of h2sl.
+ *
+ * Copyright (C) 2014 by the Massachusetts Institute of Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/gpl-2.0.html> or write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * @section DESCRIPTION
+ *
+ * The implementation of a class used to connect a coordinator process to local worker processes
+ */
+
+#include <cstdlib>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "h2sl/process_group.h"
+
+using namespace std;
+using namespace h2sl;
+
+typedef enum {
+  PROCESS_GROUP_COMMAND_STOP,
+  PROCESS_GROUP_COMMAND_EVALUATE,
+  PROCESS_GROUP_COMMAND_FINISH
+} process_group_command_t;
+
+/**
+ * reads exactly size bytes, returning false if the other end closed the socket or failed
+ */
+static bool
+read_all( const int& socket,
+          void* data,
+          const size_t& size ){
+  char * buffer = ( char* )( data );
+  size_t offset = 0;
+  while( offset < size ){
+    ssize_t count = ::read( socket, buffer + offset, size - offset );
+    if( count > 0 ){
+      offset += count;
+    } else if( ( count < 0 ) && ( errno == EINTR ) ){
+      continue;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool
+write_all( const int& socket,
+            const void* data,
+            const size_t& size ){
+  const char * buffer = ( const char* )( data );
+  size_t offset = 0;
+  while( offset < size ){
+    ssize_t count = ::send( socket, buffer + offset, size - offset, MSG_NOSIGNAL );
+    if( count > 0 ){
+      offset += count;
+    } else if( ( count < 0 ) && ( errno == EINTR ) ){
+      continue;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+Process_Group::
+Process_Group() : _rank( 0 ),
+                  _finished( false ),
+                  _sockets(),
+                  _pids() {
+
+}
+
+Process_Group::
+~Process_Group() {
+  stop();
+}
+
+/**
+ * forks numWorkers worker processes and returns the rank of the calling process: 0 in the 
+ * coordinator and 1 to numWorkers in the workers, which are only connected to the coordinator
+ */
+unsigned int
+Process_Group::
+fork( const unsigned int& numWorkers ){
+  for( unsigned int i = 0; i < numWorkers; i++ ){
+    int sockets[ 2 ];
+    if( socketpair( AF_UNIX, SOCK_STREAM, 0, sockets ) != 0 ){
+      cout << "could not create a socket pair for worker " << i + 1 << endl;
+      exit(1);
+    }
+    cout.flush();
+    pid_t pid = ::fork();
+    if( pid < 0 ){
+      cout << "could not fork worker " << i + 1 << endl;
+      exit(1);
+    } else if( pid == 0 ){
+      for( unsigned int j = 0; j < _sockets.size(); j++ ){
+        ::close( _sockets[ j ] );
+      }
+      ::close( sockets[ 0 ] );
+      _sockets.assign( 1, sockets[ 1 ] );
+      _pids.clear();
+      _rank = i + 1;
+      return _rank;
+    }
+    ::close( sockets[ 1 ] );
+    _sockets.push_back( sockets[ 0 ] );
+    _pids.push_back( pid );
+  }
+  return _rank;
+}
+
+/**
+ * sends the weights to every worker so that they evaluate their shards while the coordinator evaluates its own
+ */
+void
+Process_Group::
+broadcast( const vector< double >& weights ){
+  _send_weights( PROCESS_GROUP_COMMAND_EVALUATE, weights );
+  return;
+}
+
+/**
+ * sends the trained weights to every worker, which stops serving evaluations and answers once with 
+ * a report that the coordinator collects with gather()
+ */
+void
+Process_Group::
+finish( const vector< double >& weights ){
+  _send_weights( PROCESS_GROUP_COMMAND_FINISH, weights );
+  return;
+}
+
+/**
+ * reads the report of every worker after finish(), in rank order
+ */
+void
+Process_Group::
+gather( vector< vector< double > >& values ){
+  values.resize( _sockets.size() );
+  for( unsigned int i = 0; i < _sockets.size(); i++ ){
+    unsigned long long size = 0;
+    bool success = read_all( _sockets[ i ], &size, sizeof( size ) );
+    if( success ){
+      values[ i ].resize( size );
+      success = read_all( _sockets[ i ], values[ i ].data(), size * sizeof( double ) );
+    }
+    if( !success ){
+      cout << "lost worker " << i + 1 << endl;
+      exit(1);
+    }
+  }
+  return;
+}
+
+void
+Process_Group::
+_send_weights( const unsigned int& command,
+               const vector< double >& weights ){
+  unsigned long long size = weights.size();
+  for( unsigned int i = 0; i < _sockets.size(); i++ ){
+    if( !write_all( _sockets[ i ], &command, sizeof( command ) ) || 
+        !write_all( _sockets[ i ], &size, sizeof( size ) ) ||
+        !write_all( _sockets[ i ], weights.data(), size * sizeof( double ) ) ){
+      cout << "lost worker " << i + 1 << endl;
+      exit(1);
+    }
+  }
+  return;
+}
+
+/**
+ * adds the objective and gradient of every worker, in rank order, to objective and gradient
+ */
+void
+Process_Group::
+reduce( double& objective,
+        vector< double >& gradient ){
+  vector< unsigned int > indices;
+  vector< double > values;
+  for( unsigned int i = 0; i < _sockets.size(); i++ ){
+    double worker_objective = 0.0;
+    unsigned long long size = 0;
+    bool success = read_all( _sockets[ i ], &worker_objective, sizeof( worker_objective ) ) && read_all( _sockets[ i ], &size, sizeof( size ) );
+    if( success ){
+      indices.resize( size );
+      values.resize( size );
+      success = read_all( _sockets[ i ], indices.data(), size * sizeof( unsigned int ) ) && read_all( _sockets[ i ], values.data(), size * sizeof( double ) );
+    }
+    if( !success ){
+      cout << "lost worker " << i + 1 << endl;
+      exit(1);
+    }
+    objective += worker_objective;
+    for( unsigned int j = 0; j < indices.size(); j++ ){
+      if( indices[ j ] < gradient.size() ){
+        gradient[ indices[ j ] ] += values[ j ];
+      }
+    }
+  }
+  return;
+}
+
+/**
+ * tells the workers to exit and waits for them
+ */
+void
+Process_Group::
+stop( void ){
+  unsigned int command = PROCESS_GROUP_COMMAND_STOP;
+  for( unsigned int i = 0; i < _sockets.size(); i++ ){
+    if( _rank == 0 ){
+      write_all( _sockets[ i ], &command, sizeof( command ) );
+    }
+    ::close( _sockets[ i ] );
+  }
+  _sockets.clear();
+  for( unsigned int i = 0; i < _pids.size(); i++ ){
+    waitpid( _pids[ i ], NULL, 0 );
+  }
+  _pids.clear();
+  return;
+}
+
+/**
+ * waits in a worker for the next weights, returning false when the coordinator stops or finishes 
+ * the group; a finished group leaves the trained weights in weights and sets finished()
+ */
+bool
+Process_Group::
+receive( vector< double >& weights ){
+  if( _sockets.empty() ){
+    return false;
+  }
+  unsigned int command = PROCESS_GROUP_COMMAND_STOP;
+  if( !read_all( _sockets.front(), &command, sizeof( command ) ) || ( ( command != PROCESS_GROUP_COMMAND_EVALUATE ) && ( command != PROCESS_GROUP_COMMAND_FINISH ) ) ){
+    return false;
+  }
+  unsigned long long size = 0;
+  if( !read_all( _sockets.front(), &size, sizeof( size ) ) ){
+    return false;
+  }
+  weights.resize( size );
+  if( !read_all( _sockets.front(), weights.data(), size * sizeof( double ) ) ){
+    return false;
+  }
+  _finished = ( command == PROCESS_GROUP_COMMAND_FINISH );
+  return !_finished;
+}
+
+/**
+ * sends the objective and the nonzero entries of the gradient of a worker's shard to the coordinator
+ */
+void
+Process_Group::
+send( const double& objective,
+      const vector< double >& gradient ){
+  vector< unsigned int > indices;
+  vector< double > values;
+  for( unsigned int i = 0; i < gradient.size(); i++ ){
+    if( gradient[ i ] != 0.0 ){
+      indices.push_back( i );
+      values.push_back( gradient[ i ] );
+    }
+  }
+  unsigned long long size = indices.size();
+  if( _sockets.empty() ||
+      !write_all( _sockets.front(), &objective, sizeof( objective ) ) ||
+      !write_all( _sockets.front(), &size, sizeof( size ) ) ||
+      !write_all( _sockets.front(), indices.data(), size * sizeof( unsigned int ) ) ||
+      !write_all( _sockets.front(), values.data(), size * sizeof( double ) ) ){
+    cout << "worker " << _rank << " lost the coordinator" << endl;
+    exit(1);
+  }
+  return;
+}
+
+/**
+ * sends the report of a worker to the coordinator once the group is finished
+ */
+void
+Process_Group::
+send( const vector< double >& values ){
+  unsigned long long size = values.size();
+  if( _sockets.empty() ||
+      !write_all( _sockets.front(), &size, sizeof( size ) ) ||
+      !write_all( _sockets.front(), values.data(), size * sizeof( double ) ) ){
+    cout << "worker " << _rank << " lost the coordinator" << endl;
+    exit(1);
+  }
+  return;
+}
@@ -0,0 +1,206 @@
+/**
+ * @file    telemetry.cc
+ * @author  Thomas M. Howard (tmhoward@csail.mit.edu)
+ *          Matthew R. Walter (mwalter@csail.mit.edu)
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This file is part of h2sl.
+ *
+ * Copyright (C) 2014 by the Massachusetts Institute of Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/gpl-2.0.html> or write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * @section DESCRIPTION
+ *
+ * The implementation of a class used to record training telemetry as JSON lines
+ */
+
+#include <iomanip>
+#include <limits>
+#include <sys/resource.h>
+
+#include "h2sl/telemetry.h"
+#include "h2sl/common.h"
+
+using namespace std;
+using namespace h2sl;
+
+/**
+ * returns a JSON number, writing values that JSON cannot represent as null
+ */
+static string
+json_number( const double& value ){
+  if( ( value != value ) || ( value == numeric_limits< double >::infinity() ) || ( value == -numeric_limits< double >::infinity() ) ){
+    return "null";
+  }
+  stringstream tmp;
+  tmp << setprecision( 10 ) << value;
+  return tmp.str();
+}
+
+/**
+ * returns a quoted JSON string, escaping quotes, backslashes and control characters
+ */
+static string
+json_string( const string& value ){
+  stringstream tmp;
+  tmp << "\"";
+  for( unsigned int i = 0; i < value.size(); i++ ){
+    if( ( value[ i ] == '"' ) || ( value[ i ] == '\\' ) ){
+      tmp << '\\' << value[ i ];
+    } else if( ( unsigned char )( value[ i ] ) < 0x20 ){
+      tmp << "\\u" << hex << setw( 4 ) << setfill( '0' ) << ( unsigned int )( value[ i ] ) << dec;
+    } else {
+      tmp << value[ i ];
+    }
+  }
+  tmp << "\"";
+  return tmp.str();
+}
+
+Telemetry_Record::
+Telemetry_Record( const string& event ) : _fields() {
+  if( !event.empty() ){
+    add( "event", event );
+  }
+}
+
+Telemetry_Record::
+~Telemetry_Record() {
+
+}
+
+Telemetry_Record::
+Telemetry_Record( const Telemetry_Record& other ) : _fields( other._fields ) {
+
+}
+
+Telemetry_Record&
+Telemetry_Record::
+operator=( const Telemetry_Record& other ) {
+  _fields = other._fields;
+  return (*this);
+}
+
+Telemetry_Record&
+Telemetry_Record::
+add( const string& name,
+      const double& value ){
+  _fields += ( _fields.empty() ? "" : "," ) + json_string( name ) + ":" + json_number( value );
+  return (*this);
+}
+
+Telemetry_Record&
+Telemetry_Record::
+add( const string& name,
+      const string& value ){
+  _fields += ( _fields.empty() ? "" : "," ) + json_string( name ) + ":" + json_string( value );
+  return (*this);
+}
+
+Telemetry_Record&
+Telemetry_Record::
+add( const string& name,
+      const vector< double >& values ){
+  string tmp = "[";
+  for( unsigned int i = 0; i < values.size(); i++ ){
+    tmp += ( i == 0 ? "" : "," ) + json_number( values[ i ] );
+  }
+  tmp += "]";
+  _fields += ( _fields.empty() ? "" : "," ) + json_string( name ) + ":" + tmp;
+  return (*this);
+}
+
+string
+Telemetry_Record::
+str( void )const{
+  return "{" + _fields + "}";
+}
+
+Telemetry::
+Telemetry() : _out(),
+              _mutex(),
+              _start_time() {
+  gettimeofday( &_start_time, NULL );
+}
+
+Telemetry::
+~Telemetry() {
+  close();
+}
+
+bool
+Telemetry::
+open( const string& filename ){
+  boost::mutex::scoped_lock lock( _mutex );
+  if( _out.is_open() ){
+    _out.close();
+  }
+  _out.open( filename.c_str(), ios::out | ios::trunc );
+  gettimeofday( &_start_time, NULL );
+  return _out.is_open();
+}
+
+void
+Telemetry::
+close( void ){
+  boost::mutex::scoped_lock lock( _mutex );
+  if( _out.is_open() ){
+    _out.close();
+  }
+  return;
+}
+
+void
+Telemetry::
+write( const string& event,
+        const Telemetry_Record& record ){
+  Telemetry_Record line( event );
+  line.add( "time", elapsed() );
+  string fields = record.str();
+  string line_string = line.str();
+  if( fields.size() > 2 ){
+    line_string = line_string.substr( 0, line_string.size() - 1 ) + "," + fields.substr( 1 );
+  }
+  boost::mutex::scoped_lock lock( _mutex );
+  if( _out.is_open() ){
+    _out << line_string << endl;
+  }
+  return;
+}
+
+double
+Telemetry::
+elapsed( void )const{
+  struct timeval start_time = _start_time;
+  struct timeval now;
+  gettimeofday( &now, NULL );
+  return diff_time( start_time, now );
+}
+
+/**
+ * returns the peak resident set size of the process in megabytes
+ */
+double
+Telemetry::
+max_rss( void ){
+  struct rusage usage;
+  getrusage( RUSAGE_SELF, &usage );
+  return ( double )( usage.ru_maxrss ) / 1024.0;
+}
@@ -0,0 +1,134 @@
+/**
+ * @file    thread_pool.cc
+ * @author  Thomas M. Howard (tmhoward@csail.mit.edu)
+ *          Matthew R. Walter (mwalter@csail.mit.edu)
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This file is part of h2sl.
+ *
+ * Copyright (C) 2014 by the Massachusetts Institute of Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/gpl-2.0.html> or write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * @section DESCRIPTION
+ *
+ * The implementation of a class used to represent a persistent pool of worker threads
+ */
+
+#include <assert.h>
+
+#include "h2sl/thread_pool.h"
+
+using namespace std;
+using namespace h2sl;
+
+Thread_Pool::
+Thread_Pool( const unsigned int& numThreads ) : _threads(),
+                                                _jobs(),
+                                                _mutex(),
+                                                _job_condition(),
+                                                _done_condition(),
+                                                _generation( 0 ),
+                                                _num_pending( 0 ),
+                                                _shutdown( false ) {
+  for( unsigned int i = 0; i < numThreads; i++ ){
+    _threads.push_back( new boost::thread( &Thread_Pool::_worker, this, i ) );
+  }
+}
+
+Thread_Pool::
+~Thread_Pool() {
+  {
+    boost::mutex::scoped_lock lock( _mutex );
+    _shutdown = true;
+  }
+  _job_condition.notify_all();
+
+  for( unsigned int i = 0; i < _threads.size(); i++ ){
+    if( _threads[ i ] != NULL ){
+      _threads[ i ]->join();
+      delete _threads[ i ];
+      _threads[ i ] = NULL;
+    }
+  }
+  _threads.clear();
+}
+
+/**
+ * runs jobs[ i ] on worker ( i % size() ) and blocks until every job has finished
+ */
+void
+Thread_Pool::
+run( const vector< boost::function< void( void ) > >& jobs ){
+  if( _threads.empty() ){
+    for( unsigned int i = 0; i < jobs.size(); i++ ){
+      jobs[ i ]();
+    }
+    return;
+  }
+
+  for( unsigned int offset = 0; offset < jobs.size(); offset += _threads.size() ){
+    boost::mutex::scoped_lock lock( _mutex );
+    _jobs.assign( jobs.begin() + offset, jobs.begin() + min( jobs.size(), offset + _threads.size() ) );
+    _num_pending = _threads.size();
+    _generation++;
+    _job_condition.notify_all();
+    while( _num_pending > 0 ){
+      _done_condition.wait( lock );
+    }
+    _jobs.clear();
+  }
+  return;
+}
+
+void
+Thread_Pool::
+_worker( const unsigned int& index ){
+  unsigned int generation = 0;
+  while( true ){
+    boost::function< void( void ) > job;
+    {
+      boost::mutex::scoped_lock lock( _mutex );
+      while( !_shutdown && ( generation == _generation ) ){
+        _job_condition.wait( lock );
+      }
+      if( _shutdown ){
+        return;
+      }
+      generation = _generation;
+      if( index < _jobs.size() ){
+        job = _jobs[ index ];
+      }
+    }
+
+    if( job ){
+      job();
+    }
+
+    {
+      boost::mutex::scoped_lock lock( _mutex );
+      assert( _num_pending > 0 );
+      _num_pending--;
+      if( _num_pending == 0 ){
+        _done_condition.notify_one();
+      }
+    }
+  }
+  return;
+}
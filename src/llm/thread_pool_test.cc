@@ -0,0 +1,200 @@
+/**
+ * @file    thread_pool_test.cc
+ * @author  Thomas M. Howard (tmhoward@csail.mit.edu)
+ *          Matthew R. Walter (mwalter@csail.mit.edu)
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This file is part of h2sl.
+ *
+ * Copyright (C) 2014 by the Massachusetts Institute of Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/gpl-2.0.html> or write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * @section DESCRIPTION
+ *
+ * A Thread_Pool class test program
+ */
+
+#include <iostream>
+#include <vector>
+#include <boost/bind/bind.hpp>
+
+#include "h2sl/thread_pool.h"
+#include "thread_pool_test_cmdline.h"
+
+using namespace std;
+using namespace h2sl;
+
+/**
+ * counts a run of a job and records the thread that ran it
+ */
+void
+count_job( unsigned int& count,
+            boost::thread::id& thread ){
+  count++;
+  thread = boost::this_thread::get_id();
+  return;
+}
+
+/**
+ * pulls indices off the queue and counts each one that this thread was given
+ */
+void
+drain_queue( Work_Queue& queue,
+              vector< unsigned int >& counts ){
+  unsigned int index = 0;
+  while( queue.next( index ) ){
+    counts[ index ]++;
+  }
+  return;
+}
+
+/**
+ * checks that every job of every run is run once and that job i always runs on worker i % size()
+ */
+bool
+test_run( const unsigned int& numThreads,
+          const unsigned int& numJobs,
+          const unsigned int& numRuns ){
+  Thread_Pool thread_pool( numThreads );
+  if( thread_pool.size() != numThreads ){
+    cout << "  pool has " << thread_pool.size() << " threads instead of " << numThreads << endl;
+    return false;
+  }
+
+  vector< unsigned int > counts( numJobs, 0 );
+  vector< boost::thread::id > threads( numJobs );
+  vector< boost::thread::id > first_threads;
+  vector< boost::function< void( void ) > > jobs;
+  for( unsigned int i = 0; i < numJobs; i++ ){
+    jobs.push_back( boost::bind( count_job, boost::ref( counts[ i ] ), boost::ref( threads[ i ] ) ) );
+  }
+
+  for( unsigned int run = 0; run < numRuns; run++ ){
+    thread_pool.run( jobs );
+    if( run == 0 ){
+      first_threads = threads;
+    }
+    for( unsigned int i = 0; i < numJobs; i++ ){
+      if( counts[ i ] != run + 1 ){
+        cout << "  job " << i << " ran " << counts[ i ] << " times after " << run + 1 << " runs" << endl;
+        return false;
+      }
+      if( threads[ i ] != first_threads[ i ] ){
+        cout << "  job " << i << " moved to another thread in run " << run << endl;
+        return false;
+      }
+      if( ( numThreads == 0 ) && ( threads[ i ] != boost::this_thread::get_id() ) ){
+        cout << "  job " << i << " did not run on the calling thread of an empty pool" << endl;
+        return false;
+      }
+      if( ( numThreads > 0 ) && ( threads[ i ] != threads[ i % numThreads ] ) ){
+        cout << "  job " << i << " did not run on worker " << i % numThreads << endl;
+        return false;
+      }
+    }
+  }
+
+  thread_pool.run( vector< boost::function< void( void ) > >() );
+  return true;
+}
+
+/**
+ * checks that the workers of a pool pulling off one queue are handed every index exactly once
+ */
+bool
+test_work_queue( const unsigned int& numThreads,
+                  const unsigned int& size ){
+  Thread_Pool thread_pool( numThreads );
+  Work_Queue queue( size );
+  vector< vector< unsigned int > > counts( numThreads, vector< unsigned int >( size, 0 ) );
+  vector< boost::function< void( void ) > > jobs;
+  for( unsigned int i = 0; i < numThreads; i++ ){
+    jobs.push_back( boost::bind( drain_queue, boost::ref( queue ), boost::ref( counts[ i ] ) ) );
+  }
+  thread_pool.run( jobs );
+
+  for( unsigned int i = 0; i < size; i++ ){
+    unsigned int count = 0;
+    for( unsigned int j = 0; j < numThreads; j++ ){
+      count += counts[ j ][ i ];
+    }
+    if( count != 1 ){
+      cout << "  index " << i << " was handed out " << count << " times" << endl;
+      return false;
+    }
+  }
+
+  unsigned int index = 0;
+  if( queue.next( index ) ){
+    cout << "  drained queue handed out index " << index << endl;
+    return false;
+  }
+  return true;
+}
+
+int
+main( int argc,
+      char* argv[] ) {
+  int status = 0;
+  cout << "start of Thread_Pool class test program" << endl;
+
+  gengetopt_args_info args;
+  if( cmdline_parser( argc, argv, &args ) != 0 ){
+    exit(1);
+  }
+
+  if( ( args.threads_arg < 0 ) || ( args.jobs_arg < 0 ) || ( args.runs_arg < 1 ) ){
+    cout << "--threads and --jobs must not be negative and --runs must be positive" << endl;
+    exit(1);
+  }
+
+  const unsigned int num_threads = args.threads_arg;
+  const unsigned int num_jobs = args.jobs_arg;
+  const unsigned int num_runs = args.runs_arg;
+
+  cout << "running " << num_jobs << " jobs " << num_runs << " times on " << num_threads << " threads" << endl;
+  if( test_run( num_threads, num_jobs, num_runs ) ){
+    cout << "  passed" << endl;
+  } else {
+    cout << "  failed" << endl;
+    status = 1;
+  }
+
+  cout << "running " << num_jobs << " jobs " << num_runs << " times without threads" << endl;
+  if( test_run( 0, num_jobs, num_runs ) ){
+    cout << "  passed" << endl;
+  } else {
+    cout << "  failed" << endl;
+    status = 1;
+  }
+
+  if( num_threads > 0 ){
+    cout << "draining a work queue of " << num_jobs * num_runs << " indices on " << num_threads << " threads" << endl;
+    if( test_work_queue( num_threads, num_jobs * num_runs ) ){
+      cout << "  passed" << endl;
+    } else {
+      cout << "  failed" << endl;
+      status = 1;
+    }
+  }
+
+  cout << "end of Thread_Pool class test program" << endl;
+  return status;
+}
@@ -32,9 +32,19 @@
  */
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <cmath>
+#include <map>
+#include <sys/time.h>
+#include <boost/crc.hpp>
+#include <boost/bind/bind.hpp>
+#include <boost/algorithm/string.hpp>
 
+#include "h2sl/common.h"
 #include "h2sl/cv.h"
-#include "h2sl/grounding_set.h"
 #include "h2sl/region.h"
 #include "h2sl/constraint.h"
 #include "h2sl/object.h"
@@ -46,139 +56,643 @@
 using namespace std;
 using namespace h2sl;
 
+static const char* CV_NAMES[ NUM_CVS ] = { "unknown", "false", "true", "inverted" };
+
+/**
+ * flags the correspondence variables that are candidates of some indexed example
+ */
+vector< bool >
+candidate_cvs( LLM_Train* llmTrain ){
+  vector< bool > candidates( NUM_CVS, false );
+  for( unsigned int i = 0; i < llmTrain->cv_sets().size(); i++ ){
+    for( unsigned int j = 0; j < llmTrain->cv_sets()[ i ].size(); j++ ){
+      if( llmTrain->cv_sets()[ i ][ j ] < NUM_CVS ){
+        candidates[ llmTrain->cv_sets()[ i ][ j ] ] = true;
+      }
+    }
+  }
+  return candidates;
+}
+
+/**
+ * prints the accuracy, log-loss and confusion matrix over all of the evaluations and the accuracy 
+ * of every file, writing the same numbers to the report when it is open; only the candidate 
+ * correspondence variables get a column of the confusion matrix
+ */
 void
-evaluate_model( LLM* llm,
-                vector< pair< unsigned int, LLM_X > >& examples ){
-  vector< unsigned int > cvs;
-  cvs.push_back( CV_FALSE );
-  cvs.push_back( CV_TRUE );
-
-  unsigned int num_correct = 0;
-  for( unsigned int i = 0; i < examples.size(); i++ ){
-    vector< Feature* > features;
-    double pygx = llm->pygx( examples[ i ].first, examples[ i ].second, cvs, features );
-//    if( pygx < 0.75 ){
-    if( examples[ i ].first == CV_TRUE ){
-      cout << "example " << i << " had pygx " << pygx << endl;
-      cout << "   filename:\"" << examples[ i ].second.filename() << "\"" << endl;
-      cout << "         cv:" << examples[ i ].first << endl;
-      if( dynamic_cast< const Region* >( examples[ i ].second.grounding() ) != NULL ){
-        cout << "  grounding:" << *static_cast< const Region* >( examples[ i ].second.grounding() ) << endl; 
-      } else if ( dynamic_cast< const Constraint* >( examples[ i ].second.grounding() ) != NULL ){
-        cout << "  grounding:" << *static_cast< const Constraint* >( examples[ i ].second.grounding() ) << endl; 
-      } else if ( dynamic_cast< const Object* >( examples[ i ].second.grounding() ) != NULL ) {
-        cout << " grounding:" << *static_cast< const Object* >( examples[ i ].second.grounding() ) << endl;
-      } else if ( dynamic_cast< const Spatial_Function* >( examples[ i ].second.grounding() ) != NULL ){
-        cout << "  grounding:" << *static_cast< const Spatial_Function* >( examples[ i ].second.grounding() ) << endl;
+print_evaluation( const vector< string >& filenames,
+                  const vector< llm_evaluation_t >& evaluations,
+                  const vector< bool >& candidates,
+                  Telemetry& report ){
+  llm_evaluation_t total;
+  memset( &total, 0, sizeof( total ) );
+  for( unsigned int i = 0; i < evaluations.size(); i++ ){
+    total.num_examples += evaluations[ i ].num_examples;
+    total.num_correct += evaluations[ i ].num_correct;
+    total.log_loss += evaluations[ i ].log_loss;
+    for( unsigned int a = 0; a < NUM_CVS; a++ ){
+      for( unsigned int b = 0; b < NUM_CVS; b++ ){
+        total.confusion[ a ][ b ] += evaluations[ i ].confusion[ a ][ b ];
       }
+    }
+  }
+  if( total.num_examples <= 0.0 ){
+    cout << "no examples to evaluate" << endl;
+    return;
+  }
 
-      for( unsigned int j = 0; j < examples[ i ].second.children().size(); j++ ){
-        if( examples[ i ].second.children()[ j ].first != NULL ){
-          cout << "child phrase:(" << *examples[ i ].second.children()[ j ].first << ")" << endl;
-        }
-        for( unsigned int k = 0; k < examples[ i ].second.children()[ j ].second.size(); k++ ){
-          if( dynamic_cast< Region* >( examples[ i ].second.children()[ j ].second[ k ] ) != NULL ){
-            cout << "children[" << j << "]:" << *static_cast< Region* >( examples[ i ].second.children()[ j ].second[ k ] ) << endl;
-          } else if( dynamic_cast< Constraint* >( examples[ i ].second.children()[ j ].second[ k ] ) != NULL ){
-            cout << "children[" << j << "]:" << *static_cast< Constraint* >( examples[ i ].second.children()[ j ].second[ k ] ) << endl;
-          } else if( dynamic_cast< Spatial_Function* >( examples[ i ].second.children()[ j ].second[ k ] ) != NULL ){
-            cout << "children[" << j << "]:" << *static_cast< Spatial_Function* >( examples[ i ].second.children()[ j ].second[ k ] ) << endl;
-          } else if( dynamic_cast< Object* >( examples[ i ].second.children()[ j ].second[ k ] ) != NULL ){
-            cout << "children[" << j << "]:" << *static_cast< Object* >( examples[ i ].second.children()[ j ].second[ k ] ) << endl;
-          }
+  cout << total.num_correct / total.num_examples * 100.0 << " accuracy (" << total.num_correct << "/" << total.num_examples << ")" << endl; 
+  cout << total.log_loss / total.num_examples << " log-loss" << endl;
+
+  cout << "confusion matrix (rows labeled, columns predicted)" << endl;
+  cout << setw( 11 ) << "";
+  for( unsigned int b = 0; b < NUM_CVS; b++ ){
+    if( candidates[ b ] ){
+      cout << setw( 11 ) << CV_NAMES[ b ];
+    }
+  }
+  cout << endl;
+  for( unsigned int a = 0; a < NUM_CVS; a++ ){
+    double num_labeled = 0.0;
+    for( unsigned int b = 0; b < NUM_CVS; b++ ){
+      num_labeled += total.confusion[ a ][ b ];
+    }
+    if( num_labeled > 0.0 ){
+      cout << setw( 11 ) << CV_NAMES[ a ];
+      for( unsigned int b = 0; b < NUM_CVS; b++ ){
+        if( candidates[ b ] ){
+          cout << setw( 11 ) << total.confusion[ a ][ b ];
         }
       }
-      cout << "     phrase:" << *examples[ i ].second.phrase() << endl;
-      cout << "     features[" << features.size() << "]" << endl;
-      for( unsigned int j = 0; j < features.size(); j++ ){
-        cout << "      feature[" << j << "]:" << *features[ j ] << endl;
-      }
       cout << endl;
-    } else {
-      num_correct++;
     }
   }
 
-  cout << ( double )( num_correct ) / ( double )( examples.size() ) * 100.0 << " accuracy (" << num_correct << "/" << examples.size() << ")" << endl; 
+  for( unsigned int i = 0; i < evaluations.size(); i++ ){
+    if( evaluations[ i ].num_examples > 0.0 ){
+      cout << "  " << filenames[ i ] << ": " << evaluations[ i ].num_correct / evaluations[ i ].num_examples * 100.0 << " accuracy (" << evaluations[ i ].num_correct << "/" << evaluations[ i ].num_examples << "), " << evaluations[ i ].log_loss / evaluations[ i ].num_examples << " log-loss" << endl;
+    }
+  }
 
+  if( report.is_open() ){
+    for( unsigned int i = 0; i < evaluations.size(); i++ ){
+      if( evaluations[ i ].num_examples > 0.0 ){
+        report.write( "evaluation_file", Telemetry_Record().add( "file", filenames[ i ] ).add( "examples", evaluations[ i ].num_examples ).add( "correct", evaluations[ i ].num_correct ).add( "accuracy", evaluations[ i ].num_correct / evaluations[ i ].num_examples ).add( "log_loss", evaluations[ i ].log_loss / evaluations[ i ].num_examples ) );
+      }
+    }
+    Telemetry_Record record;
+    record.add( "files", evaluations.size() ).add( "examples", total.num_examples ).add( "correct", total.num_correct ).add( "accuracy", total.num_correct / total.num_examples ).add( "log_loss", total.log_loss / total.num_examples );
+    for( unsigned int a = 0; a < NUM_CVS; a++ ){
+      record.add( string( "confusion_" ) + CV_NAMES[ a ], vector< double >( total.confusion[ a ], total.confusion[ a ] + NUM_CVS ) );
+    }
+    report.write( "evaluation_summary", record );
+  }
   return;
 }
 
-unsigned int
-evaluate_cv( const Grounding* grounding,
-              const Grounding_Set* groundingSet ){
-  unsigned int cv = CV_UNKNOWN;
-  if( dynamic_cast< const Region* >( grounding ) != NULL ){
-    const Region * region_grounding = dynamic_cast< const Region* >( grounding );
-    cv = CV_FALSE;
-    for( unsigned int i = 0; i < groundingSet->groundings().size(); i++ ){
-      if( dynamic_cast< const Region* >( groundingSet->groundings()[ i ] ) ){
-        if( *region_grounding == *dynamic_cast< const Region* >( groundingSet->groundings()[ i ] ) ){
-          cv = CV_TRUE;
-        }
+/**
+ * scores the indexed examples with the model across the threads and prints the evaluation; the 
+ * counts are weighted, so merged or subsampled rows count as the examples they stand for and a 
+ * merged row counts against the file of its first example
+ */
+void
+evaluate_model( LLM_Train* llmTrain,
+                const LLM* llm,
+                const vector< string >& filenames,
+                const vector< pair< unsigned int, unsigned int > >& fileRanges,
+                Telemetry& report ){
+  vector< llm_evaluation_t > evaluations;
+  llmTrain->evaluate( llm, fileRanges, evaluations );
+  print_evaluation( filenames, evaluations, candidate_cvs( llmTrain ), report );
+  return;
+}
+
+/**
+ * packs the candidate flags and the per-file evaluations of a worker into the report it sends 
+ * to the coordinator
+ */
+vector< double >
+pack_evaluations( LLM_Train* llmTrain,
+                  const vector< llm_evaluation_t >& evaluations ){
+  vector< bool > candidates = candidate_cvs( llmTrain );
+  vector< double > values( candidates.begin(), candidates.end() );
+  const unsigned int stride = sizeof( llm_evaluation_t ) / sizeof( double );
+  values.resize( NUM_CVS + evaluations.size() * stride );
+  if( !evaluations.empty() ){
+    memcpy( values.data() + NUM_CVS, evaluations.data(), evaluations.size() * sizeof( llm_evaluation_t ) );
+  }
+  return values;
+}
+
+/**
+ * finishes the process group with the trained weights and prints the evaluation of every input 
+ * file: the coordinator scores its own files while each worker scores the every processes-th file 
+ * it read, and the reports of the workers are put back into the order of filenames
+ */
+void
+evaluate_process_group( LLM_Train* llmTrain,
+                        const LLM* llm,
+                        const vector< string >& filenames,
+                        const vector< pair< unsigned int, unsigned int > >& fileRanges,
+                        Process_Group& processGroup,
+                        Telemetry& report ){
+  const unsigned int num_processes = processGroup.size();
+  processGroup.finish( llm->weights() );
+
+  vector< llm_evaluation_t > coordinator_evaluations;
+  llmTrain->evaluate( llm, fileRanges, coordinator_evaluations );
+  vector< double > coordinator_values = pack_evaluations( llmTrain, coordinator_evaluations );
+
+  vector< vector< double > > values;
+  processGroup.gather( values );
+  processGroup.stop();
+  values.insert( values.begin(), coordinator_values );
+
+  llm_evaluation_t empty;
+  memset( &empty, 0, sizeof( empty ) );
+  vector< llm_evaluation_t > evaluations( filenames.size(), empty );
+  vector< bool > candidates( NUM_CVS, false );
+  const unsigned int stride = sizeof( llm_evaluation_t ) / sizeof( double );
+  for( unsigned int rank = 0; rank < values.size(); rank++ ){
+    const unsigned int num_files = ( rank < filenames.size() ) ? ( filenames.size() - rank + num_processes - 1 ) / num_processes : 0;
+    if( values[ rank ].size() != NUM_CVS + num_files * stride ){
+      cout << "process " << rank << " reported " << values[ rank ].size() << " values instead of the evaluations of " << num_files << " files" << endl;
+      return;
+    }
+    for( unsigned int cv = 0; cv < NUM_CVS; cv++ ){
+      if( values[ rank ][ cv ] != 0.0 ){
+        candidates[ cv ] = true;
       }
     }
-  } else if ( dynamic_cast< const Constraint* >( grounding ) != NULL ){
-    const Constraint* constraint_grounding = dynamic_cast< const Constraint* >( grounding );
-    cv = CV_FALSE;
-    for( unsigned int i = 0; i < groundingSet->groundings().size(); i++ ){
-      if( dynamic_cast< const Constraint* >( groundingSet->groundings()[ i ] ) ){
-        if( *constraint_grounding == *dynamic_cast< const Constraint* >( groundingSet->groundings()[ i ] ) ){
-          cv = CV_TRUE;
+    for( unsigned int i = 0; i < num_files; i++ ){
+      memcpy( &evaluations[ rank + i * num_processes ], values[ rank ].data() + NUM_CVS + i * stride, sizeof( llm_evaluation_t ) );
+    }
+  }
+  print_evaluation( filenames, evaluations, candidates, report );
+  return;
+}
+
+/**
+ * prints a grounding in the format of its type
+ */
+void
+print_grounding( ostream& out,
+                  const Grounding* grounding ){
+  if( dynamic_cast< const Region* >( grounding ) != NULL ){
+    out << *static_cast< const Region* >( grounding );
+  } else if( dynamic_cast< const Constraint* >( grounding ) != NULL ){
+    out << *static_cast< const Constraint* >( grounding );
+  } else if( dynamic_cast< const Object* >( grounding ) != NULL ){
+    out << *static_cast< const Object* >( grounding );
+  } else if( dynamic_cast< const Spatial_Function* >( grounding ) != NULL ){
+    out << *static_cast< const Spatial_Function* >( grounding );
+  }
+  return;
+}
+
+/**
+ * reads the files again and prints the groundings, phrases and active features of every CV_TRUE 
+ * example along with its probability under the model; this extracts the features once more, serially
+ */
+void
+dump_examples( const vector< string >& filenames,
+                LLM* llm ){
+  DCG dcg;
+  unsigned int index = 0;
+  for( unsigned int i = 0; i < filenames.size(); i++ ){
+    World * world = new World();
+    world->from_xml( filenames[ i ] ); 
+    Phrase * phrase = new Phrase();
+    phrase->from_xml( filenames[ i ] ); 
+    dcg.fill_search_spaces( world );
+
+    LLM_Example_Set examples;
+    examples.scrape( filenames[ i ], phrase, world, dcg.search_spaces(), dcg.correspondence_variables() );  
+    for( unsigned int j = 0; j < examples.size(); j++, index++ ){
+      const llm_example_t& example = examples[ j ];
+      if( example.cv != CV_TRUE ){
+        continue;
+      }
+      LLM_X x( examples.grounding( example.grounding ), examples.phrase( example.phrase ), examples.world( example.world ), examples.cvs( example.cvs ), vector< Feature* >(), examples.filename( example.world ) );
+      examples.children( example, x.children() );
+      vector< Feature* > features;
+      double pygx = llm->pygx( example.cv, x, examples.cvs( example.cvs ), features );
+
+      cout << "example " << index << " had pygx " << pygx << endl;
+      cout << "   filename:\"" << x.filename() << "\"" << endl;
+      cout << "         cv:" << example.cv << endl;
+      cout << "  grounding:";
+      print_grounding( cout, x.grounding() );
+      cout << endl;
+      for( unsigned int k = 0; k < x.children().size(); k++ ){
+        if( x.children()[ k ].first != NULL ){
+          cout << "child phrase:(" << *x.children()[ k ].first << ")" << endl;
+        }
+        for( unsigned int l = 0; l < x.children()[ k ].second.size(); l++ ){
+          cout << "children[" << k << "]:";
+          print_grounding( cout, x.children()[ k ].second[ l ] );
+          cout << endl;
         }
       }
+      cout << "     phrase:" << *x.phrase() << endl;
+      cout << "     features[" << features.size() << "]" << endl;
+      for( unsigned int k = 0; k < features.size(); k++ ){
+        cout << "      feature[" << k << "]:" << *features[ k ] << endl;
+      }
+      cout << endl;
     }
-  } else if ( dynamic_cast< const Object* >( grounding ) != NULL ) {
-    const h2sl::Object* object_grounding = dynamic_cast< const h2sl::Object* >( grounding );
-    cv = CV_FALSE;
-    for( unsigned int i = 0; i < groundingSet->groundings().size(); i++ ){
-      if( dynamic_cast< const h2sl::Object* >( groundingSet->groundings()[ i ] ) ){
-        if( *object_grounding == *dynamic_cast< const h2sl::Object* >( groundingSet->groundings()[ i ] ) ){
-          cv = CV_TRUE;
+
+    delete phrase;
+    delete world;
+  }
+  return;
+}
+
+/**
+ * returns the CRC-32 of the contents of a file as a hexadecimal string
+ */
+string
+file_checksum( const string& filename ){
+  ifstream in( filename.c_str(), ios::in | ios::binary );
+  boost::crc_32_type crc;
+  char buffer[ 4096 ];
+  while( in.good() ){
+    in.read( buffer, sizeof( buffer ) );
+    crc.process_bytes( buffer, in.gcount() );
+  }
+  stringstream checksum;
+  checksum << hex << setw( 8 ) << setfill( '0' ) << crc.checksum();
+  return checksum.str();
+}
+
+/**
+ * returns a key identifying the index table computed for a feature set and a list of example files
+ */
+string
+index_cache_key( const Feature_Set* featureSet,
+                  const vector< string >& filenames,
+                  map< string, string >& checksums ){
+  stringstream key;
+  key << "feature_set:" << hex << setw( 8 ) << setfill( '0' ) << featureSet->checksum() << endl;
+  for( unsigned int i = 0; i < filenames.size(); i++ ){
+    key << filenames[ i ] << ":" << checksums[ filenames[ i ] ] << endl;
+  }
+  return key.str();
+}
+
+/**
+ * reads the example files (and their checksums) that a model written by write_model was trained on
+ */
+void
+read_training_set( const string& filename,
+                    map< string, string >& checksums ){
+  xmlDoc * doc = xmlReadFile( filename.c_str(), NULL, 0 );
+  if( doc != NULL ){
+    xmlNodePtr root = xmlDocGetRootElement( doc );
+    if( root->type == XML_ELEMENT_NODE ){
+      for( xmlNodePtr l1 = root->children; l1; l1 = l1->next ){
+        if( ( l1->type == XML_ELEMENT_NODE ) && ( xmlStrcmp( l1->name, ( const xmlChar* )( "training_set" ) ) == 0 ) ){
+          for( xmlNodePtr l2 = l1->children; l2; l2 = l2->next ){
+            if( ( l2->type == XML_ELEMENT_NODE ) && ( xmlStrcmp( l2->name, ( const xmlChar* )( "example" ) ) == 0 ) ){
+              xmlChar * example_filename = xmlGetProp( l2, ( const xmlChar* )( "filename" ) );
+              xmlChar * example_checksum = xmlGetProp( l2, ( const xmlChar* )( "checksum" ) );
+              if( ( example_filename != NULL ) && ( example_checksum != NULL ) ){
+                checksums[ ( char* )( example_filename ) ] = ( char* )( example_checksum );
+              }
+              if( example_filename != NULL ){
+                xmlFree( example_filename );
+              }
+              if( example_checksum != NULL ){
+                xmlFree( example_checksum );
+              }
+            }
+          }
         }
       }
     }
-  } else if ( dynamic_cast< const Spatial_Function* >( grounding ) != NULL ){
-    const Spatial_Function* spatial_function_grounding = dynamic_cast< const Spatial_Function* >( grounding );
-    cv = CV_FALSE;
-    for( unsigned int i = 0; i < groundingSet->groundings().size(); i++ ){
-      if( dynamic_cast< const Spatial_Function* >( groundingSet->groundings()[ i ] ) ){
-        const Spatial_Function* other_spatial_function_grounding = dynamic_cast< const Spatial_Function* >( groundingSet->groundings()[ i ] );
-        if( *spatial_function_grounding == *other_spatial_function_grounding ){
-          cv = CV_TRUE;
-        }  
+    xmlFreeDoc( doc );
+  }
+  return;
+}
+
+/**
+ * writes the model along with the example files it was trained on, which --incremental uses to find new or changed files
+ */
+void
+write_model( const LLM* llm,
+              const map< string, string >& checksums,
+              const string& filename ){
+  xmlDocPtr doc = xmlNewDoc( ( xmlChar* )( "1.0" ) );
+  xmlNodePtr root = xmlNewDocNode( doc, NULL, ( xmlChar* )( "root" ), NULL );
+  xmlDocSetRootElement( doc, root );
+  llm->to_xml( doc, root );
+  xmlNodePtr training_set_node = xmlNewDocNode( doc, NULL, ( const xmlChar* )( "training_set" ), NULL );
+  for( map< string, string >::const_iterator it = checksums.begin(); it != checksums.end(); it++ ){
+    xmlNodePtr example_node = xmlNewDocNode( doc, NULL, ( const xmlChar* )( "example" ), NULL );
+    xmlNewProp( example_node, ( const xmlChar* )( "filename" ), ( const xmlChar* )( it->first.c_str() ) );
+    xmlNewProp( example_node, ( const xmlChar* )( "checksum" ), ( const xmlChar* )( it->second.c_str() ) );
+    xmlAddChild( training_set_node, example_node );
+  }
+  xmlAddChild( root, training_set_node );
+  xmlSaveFormatFileEnc( filename.c_str(), doc, "UTF-8", 1 );
+  xmlFreeDoc( doc );
+  return;
+}
+
+/**
+ * a point of the hyperparameter grid searched by --sweep_lambda, --sweep_epsilon and --sweep_l1, the model trained with 
+ * it and its evaluation on the held-out examples (or on the training examples when nothing is held out)
+ */
+typedef struct {
+  double lambda;
+  double epsilon;
+  double l1;
+  double objective;
+  double num_examples;
+  double num_correct;
+  double log_loss;
+  double time;
+  vector< double > weights;
+} sweep_configuration_t;
+
+/**
+ * parses a comma separated list of values, returning the default value if the list was not given
+ */
+vector< double >
+sweep_values( const char* arg,
+              const double& defaultValue ){
+  vector< double > values;
+  if( arg != NULL ){
+    vector< string > value_strings;
+    boost::split( value_strings, arg, boost::is_any_of( "," ) );
+    for( unsigned int i = 0; i < value_strings.size(); i++ ){
+      values.push_back( strtod( value_strings[ i ].c_str(), NULL ) );
+    }
+  } else {
+    values.push_back( defaultValue );
+  }
+  return values;
+}
+
+/**
+ * trains configurations pulled off the queue, each with a single-threaded copy of the prepared trainer
+ */
+void
+sweep_worker( LLM_Train* prototype,
+              vector< sweep_configuration_t >& configurations,
+              Work_Queue& queue,
+              const unsigned int& maxIterations ){
+  unsigned int index = 0;
+  while( queue.next( index ) ){
+    sweep_configuration_t& configuration = configurations[ index ];
+
+    LLM llm( prototype->llms().front()->feature_set() );
+    llm.weights() = prototype->llms().front()->weights();
+
+    LLM_Train llm_train( *prototype );
+    llm_train.llms() = vector< LLM* >( 1, &llm );
+    llm_train.verbose() = false;
+    llm_train.telemetry() = NULL;
+    llm_train.l1() = configuration.l1;
+    llm_train.partition( 1 );
+
+    struct timeval start_time;
+    gettimeofday( &start_time, NULL );
+    llm_train.optimize( maxIterations, configuration.lambda, configuration.epsilon );
+    struct timeval end_time;
+    gettimeofday( &end_time, NULL );
+
+    vector< pair< unsigned int, unsigned int > > ranges = llm_train.holdout_ranges();
+    if( ranges.empty() ){
+      ranges.push_back( pair< unsigned int, unsigned int >( 0, llm_train.num_examples() ) );
+    }
+    vector< llm_evaluation_t > evaluations;
+    llm_train.evaluate( &llm, ranges, evaluations );
+
+    configuration.objective = llm_train.final_objective();
+    for( unsigned int i = 0; i < evaluations.size(); i++ ){
+      configuration.num_examples += evaluations[ i ].num_examples;
+      configuration.num_correct += evaluations[ i ].num_correct;
+      configuration.log_loss += evaluations[ i ].log_loss;
+    }
+    configuration.time = diff_time( start_time, end_time );
+    configuration.weights.swap( llm.weights() );
+  }
+  return;
+}
+
+/**
+ * trains every configuration of the grid concurrently over the indices computed by prepare() and prints 
+ * a summary; with --holdout the configuration with the highest held-out log-likelihood is chosen and its 
+ * weights are left in the prototype's first llm, otherwise the choice is left to the user and false is returned
+ */
+bool
+sweep( LLM_Train* prototype,
+        const gengetopt_args_info& args ){
+  vector< double > lambdas = sweep_values( args.sweep_lambda_arg, args.lambda_arg );
+  vector< double > epsilons = sweep_values( args.sweep_epsilon_arg, args.epsilon_arg );
+  vector< double > l1s = sweep_values( args.sweep_l1_arg, args.l1_arg );
+
+  vector< sweep_configuration_t > configurations;
+  for( unsigned int i = 0; i < lambdas.size(); i++ ){
+    for( unsigned int j = 0; j < epsilons.size(); j++ ){
+      for( unsigned int k = 0; k < l1s.size(); k++ ){
+        sweep_configuration_t configuration;
+        configuration.lambda = lambdas[ i ];
+        configuration.epsilon = epsilons[ j ];
+        configuration.l1 = l1s[ k ];
+        configuration.objective = 0.0;
+        configuration.num_examples = 0.0;
+        configuration.num_correct = 0.0;
+        configuration.log_loss = 0.0;
+        configuration.time = 0.0;
+        configurations.push_back( configuration );
       }
     }
-  }     
- 
-  return cv;
+  }
+
+  cout << "sweeping " << configurations.size() << " configurations on " << args.threads_arg << " threads" << endl;
+
+  Work_Queue queue( configurations.size() );
+  vector< boost::function< void( void ) > > jobs;
+  for( int i = 0; i < args.threads_arg; i++ ){
+    jobs.push_back( boost::bind( sweep_worker, prototype, boost::ref( configurations ), boost::ref( queue ), args.max_iterations_arg ) );
+  }
+  Thread_Pool thread_pool( args.threads_arg );
+  thread_pool.run( jobs );
+
+  // the training objective and accuracy favour the weakest regularization, so only held-out examples can choose
+  const bool choose = !prototype->holdout_ranges().empty();
+  unsigned int best = 0;
+  for( unsigned int i = 1; i < configurations.size(); i++ ){
+    if( configurations[ i ].log_loss < configurations[ best ].log_loss ){
+      best = i;
+    }
+  }
+
+  cout << "      lambda     epsilon          l1    objective " << ( choose ? "   held-out accuracy   held-out log-loss" : "   training accuracy   training log-loss" ) << "     time" << endl;
+  for( unsigned int i = 0; i < configurations.size(); i++ ){
+    const sweep_configuration_t& configuration = configurations[ i ];
+    cout << setw( 12 ) << configuration.lambda << setw( 12 ) << configuration.epsilon << setw( 12 ) << configuration.l1;
+    cout << setw( 13 ) << configuration.objective;
+    cout << setw( 20 ) << ( configuration.num_examples > 0.0 ? configuration.num_correct / configuration.num_examples * 100.0 : 0.0 );
+    cout << setw( 20 ) << ( configuration.num_examples > 0.0 ? configuration.log_loss / configuration.num_examples : 0.0 );
+    cout << setw( 9 ) << configuration.time << ( ( choose && ( i == best ) ) ? " *" : "" ) << endl;
+  }
+
+  if( prototype->telemetry() != NULL ){
+    for( unsigned int i = 0; i < configurations.size(); i++ ){
+      const sweep_configuration_t& configuration = configurations[ i ];
+      prototype->telemetry()->write( "sweep_configuration", Telemetry_Record().add( "lambda", configuration.lambda ).add( "epsilon", configuration.epsilon ).add( "l1", configuration.l1 ).add( "objective", configuration.objective ).add( "evaluated", choose ? "holdout" : "training" ).add( "examples", configuration.num_examples ).add( "correct", configuration.num_correct ).add( "log_loss", configuration.log_loss ).add( "seconds", configuration.time ).add( "best", ( double )( choose && ( i == best ) ) ) );
+    }
+  }
+
+  if( !choose ){
+    cout << "no configuration chosen, give --holdout to choose by the held-out files or train again with the preferred values" << endl;
+    return false;
+  }
+
+  if( !configurations.empty() ){
+    prototype->llms().front()->weights().swap( configurations[ best ].weights );
+  }
+  return true;
 }
 
+/**
+ * a fold of --folds cross-validation: the input files it holds out and the model trained without them
+ */
+typedef struct {
+  vector< unsigned int > files;
+  vector< pair< unsigned int, unsigned int > > training_ranges;
+  vector< pair< unsigned int, unsigned int > > test_ranges;
+  unsigned int num_training;
+  unsigned int num_test;
+  double num_correct;
+  double objective;
+  double time;
+} fold_t;
+
+/**
+ * trains folds pulled off the queue on the rows of the other folds and counts the correct held-out examples
+ */
 void
-scrape_examples( const string& filename,
-                  const Phrase* phrase,
-                  const World* world,
-                  const vector< pair< unsigned int, Grounding* > >& searchSpaces,
-                  const vector< vector< unsigned int > >& correspondenceVariables,
-                  vector< pair< unsigned int, LLM_X > >& examples ){
-  const Grounding_Set * grounding_set = dynamic_cast< const Grounding_Set* >( phrase->grounding() );
-
-  for( unsigned int i = 0; i < searchSpaces.size(); i++ ){
-    examples.push_back( pair< unsigned int, LLM_X >( evaluate_cv( searchSpaces[ i ].second, grounding_set ), LLM_X( searchSpaces[ i ].second, phrase, world, correspondenceVariables[ searchSpaces[ i ].first ], vector< Feature* >(), filename ) ) );
-    for( unsigned int j = 0; j < phrase->children().size(); j++ ){
-      examples.back().second.children().push_back( pair< const Phrase*, vector< Grounding* > >( phrase->children()[ j ], vector< Grounding* >() ) );
-      Grounding_Set * child_grounding_set = dynamic_cast< Grounding_Set* >( phrase->children()[ j ]->grounding() );
-      if( child_grounding_set ){
-        for( unsigned int k = 0; k < child_grounding_set->groundings().size(); k++ ){
-          examples.back().second.children().back().second.push_back( child_grounding_set->groundings()[ k ] );
-        }   
+cross_validation_worker( LLM_Train* prototype,
+                          vector< fold_t >& folds,
+                          Work_Queue& queue,
+                          const unsigned int& maxIterations,
+                          const double& lambda,
+                          const double& epsilon ){
+  unsigned int index = 0;
+  while( queue.next( index ) ){
+    fold_t& fold = folds[ index ];
+
+    LLM llm( prototype->llms().front()->feature_set() );
+    llm.weights() = prototype->llms().front()->weights();
+
+    LLM_Train llm_train( *prototype );
+    llm_train.llms() = vector< LLM* >( 1, &llm );
+    llm_train.verbose() = false;
+    llm_train.telemetry() = NULL;
+    llm_train.row_ranges() = fold.training_ranges;
+    llm_train.partition( 1 );
+
+    struct timeval start_time;
+    gettimeofday( &start_time, NULL );
+    llm_train.optimize( maxIterations, lambda, epsilon );
+    struct timeval end_time;
+    gettimeofday( &end_time, NULL );
+
+    fold.objective = llm_train.final_objective();
+    fold.time = diff_time( start_time, end_time );
+    fold.num_correct = 0.0;
+    for( unsigned int i = 0; i < fold.test_ranges.size(); i++ ){
+      fold.num_correct += llm_train.num_correct( &llm, fold.test_ranges[ i ].first, fold.test_ranges[ i ].second );
+    }
+  }
+  return;
+}
+
+/**
+ * estimates the accuracy of the model with k-fold cross-validation over the input files, training 
+ * the folds concurrently over the indices computed by prepare()
+ */
+void
+cross_validate( LLM_Train* prototype,
+                const vector< string >& filenames,
+                const vector< pair< unsigned int, unsigned int > >& fileRanges,
+                const gengetopt_args_info& args ){
+  const unsigned int num_folds = min( ( unsigned int )( args.folds_arg ), ( unsigned int )( fileRanges.size() ) );
+  if( num_folds < 2 ){
+    cout << "cross-validation needs at least two folds and two input files" << endl;
+    return;
+  }
+
+  vector< fold_t > folds( num_folds );
+  for( unsigned int i = 0; i < fileRanges.size(); i++ ){
+    for( unsigned int j = 0; j < num_folds; j++ ){
+      vector< pair< unsigned int, unsigned int > >& ranges = ( i % num_folds == j ) ? folds[ j ].test_ranges : folds[ j ].training_ranges;
+      if( !ranges.empty() && ( ranges.back().second == fileRanges[ i ].first ) ){
+        ranges.back().second = fileRanges[ i ].second;
+      } else {
+        ranges.push_back( fileRanges[ i ] );
       }
     }
+    folds[ i % num_folds ].files.push_back( i );
   }
+  for( unsigned int i = 0; i < folds.size(); i++ ){
+    folds[ i ].num_training = 0;
+    for( unsigned int j = 0; j < folds[ i ].training_ranges.size(); j++ ){
+      folds[ i ].num_training += folds[ i ].training_ranges[ j ].second - folds[ i ].training_ranges[ j ].first;
+    }
+    folds[ i ].num_test = 0;
+    for( unsigned int j = 0; j < folds[ i ].test_ranges.size(); j++ ){
+      folds[ i ].num_test += folds[ i ].test_ranges[ j ].second - folds[ i ].test_ranges[ j ].first;
+    }
+  }
+
+  cout << "cross-validating " << num_folds << " folds on " << args.threads_arg << " threads" << endl;
+
+  struct timeval start_time;
+  gettimeofday( &start_time, NULL );
 
-  for( unsigned int i = 0; i < phrase->children().size(); i++ ){
-    scrape_examples( filename, phrase->children()[ i ], world, searchSpaces, correspondenceVariables, examples );
+  Work_Queue queue( folds.size() );
+  vector< boost::function< void( void ) > > jobs;
+  for( int i = 0; i < args.threads_arg; i++ ){
+    jobs.push_back( boost::bind( cross_validation_worker, prototype, boost::ref( folds ), boost::ref( queue ), args.max_iterations_arg, args.lambda_arg, args.epsilon_arg ) );
   }
+  Thread_Pool thread_pool( args.threads_arg );
+  thread_pool.run( jobs );
+
+  struct timeval end_time;
+  gettimeofday( &end_time, NULL );
+
+  double num_correct = 0.0;
+  unsigned int num_test = 0;
+  double sum_accuracy = 0.0;
+  double sum_squared_accuracy = 0.0;
+  for( unsigned int i = 0; i < folds.size(); i++ ){
+    double accuracy = ( folds[ i ].num_test > 0 ) ? folds[ i ].num_correct / ( double )( folds[ i ].num_test ) * 100.0 : 0.0;
+    cout << "fold " << i << " held out";
+    for( unsigned int j = 0; j < folds[ i ].files.size(); j++ ){
+      cout << " " << filenames[ folds[ i ].files[ j ] ];
+    }
+    cout << endl;
+    cout << "  trained on " << folds[ i ].num_training << " examples in " << folds[ i ].time << " seconds (objective " << folds[ i ].objective << ")" << endl;
+    cout << "  " << accuracy << " accuracy (" << folds[ i ].num_correct << "/" << folds[ i ].num_test << ")" << endl;
+    if( prototype->telemetry() != NULL ){
+      prototype->telemetry()->write( "fold", Telemetry_Record().add( "fold", i ).add( "training_examples", folds[ i ].num_training ).add( "test_examples", folds[ i ].num_test ).add( "correct", folds[ i ].num_correct ).add( "objective", folds[ i ].objective ).add( "seconds", folds[ i ].time ) );
+    }
+    num_correct += folds[ i ].num_correct;
+    num_test += folds[ i ].num_test;
+    sum_accuracy += accuracy;
+    sum_squared_accuracy += accuracy * accuracy;
+  }
+
+  double mean_accuracy = sum_accuracy / ( double )( folds.size() );
+  double std_accuracy = sqrt( max( 0.0, sum_squared_accuracy / ( double )( folds.size() ) - mean_accuracy * mean_accuracy ) );
+  cout << "cross-validation accuracy " << mean_accuracy << " +/- " << std_accuracy << " over " << folds.size() << " folds";
+  cout << " (" << ( num_test > 0 ? num_correct / ( double )( num_test ) * 100.0 : 0.0 ) << " pooled, " << num_correct << "/" << num_test << ")";
+  cout << " in " << diff_time( start_time, end_time ) << " seconds" << endl;
   return;
 }
 
@@ -190,50 +704,303 @@ main( int argc,
     exit(1);
   }
 
-  vector< DCG* > dcgs( args.inputs_num, NULL );
-  vector< Phrase* > phrases( args.inputs_num, NULL );
-  vector< World* > worlds( args.inputs_num, NULL );
-  vector< string > filenames( args.inputs_num );
+  if( !args.feature_set_given && !args.llm_given ){
+    cout << "either --feature_set or --llm must be given" << endl;
+    exit(1);
+  }
+
+  if( args.folds_given && ( args.sweep_lambda_given || args.sweep_epsilon_given || args.sweep_l1_given ) ){
+    cout << "--folds cannot be combined with a sweep" << endl;
+    exit(1);
+  }
+
+  if( ( args.processes_arg > 1 ) && ( args.folds_given || args.sweep_lambda_given || args.sweep_epsilon_given || args.sweep_l1_given ) ){
+    cout << "--processes cannot be combined with --folds or a sweep" << endl;
+    exit(1);
+  }
+
+  if( args.hash_size_given && ( args.llm_given || ( args.hash_size_arg <= 0 ) ) ){
+    cout << "--hash_size must be positive and cannot be combined with --llm, whose feature set already fixes the weights" << endl;
+    exit(1);
+  }
+
+  if( args.holdout_given && ( ( args.holdout_arg <= 0 ) || ( ( unsigned int )( args.holdout_arg ) >= args.inputs_num ) ) ){
+    cout << "--holdout must leave at least one input file for training" << endl;
+    exit(1);
+  }
+
+  if( ( args.patience_arg <= 0 ) || ( args.holdout_interval_arg <= 0 ) ){
+    cout << "--patience and --holdout_interval must be positive" << endl;
+    exit(1);
+  }
+
+  if( args.holdout_given && ( args.folds_given || args.deduplicate_flag || args.incremental_flag || ( args.processes_arg > 1 ) ) ){
+    cout << "--holdout cannot be combined with --folds, --deduplicate, --incremental or --processes" << endl;
+    exit(1);
+  }
+
+  if( ( args.negatives_given && ( args.negatives_arg <= 0 ) ) || ( args.hard_negatives_flag && !args.negatives_given ) ){
+    cout << "--negatives must be positive and is required by --hard_negatives" << endl;
+    exit(1);
+  }
+
+  // hardness is measured with the starting weights, which are all zero without --llm
+  if( args.hard_negatives_flag && !args.llm_given ){
+    cout << "--hard_negatives requires --llm to measure how hard the negatives are" << endl;
+    exit(1);
+  }
+
+  if( ( args.deduplicate_flag || args.negatives_given ) && args.folds_given ){
+    cout << "--deduplicate and --negatives cannot be combined with --folds" << endl;
+    exit(1);
+  }
+
+  // both rebuild the index table in memory, which would load all of the shards back into it
+  if( ( args.deduplicate_flag || args.negatives_given ) && args.out_of_core_given ){
+    cout << "--deduplicate and --negatives cannot be combined with --out_of_core" << endl;
+    exit(1);
+  }
+
+  if( args.incremental_flag && !args.llm_given ){
+    cout << "--incremental requires --llm" << endl;
+    exit(1);
+  }
+
+  // the checksums of the files a model was trained on are only stored in the xml format
+  if( args.incremental_flag && LLM::is_binary( args.llm_arg ) ){
+    cout << "--incremental requires an xml --llm, " << args.llm_arg << " is binary and has no record of its training files" << endl;
+    exit(1);
+  }
+
+  map< string, string > checksums;
+  if( args.llm_given && !LLM::is_binary( args.llm_arg ) ){
+    read_training_set( args.llm_arg, checksums );
+  }
 
-  vector< pair< unsigned int, LLM_X > > examples;
+  vector< string > filenames;
   for( unsigned int i = 0; i < args.inputs_num; i++ ){
-    cout << "reading file " << args.inputs[ i ] << endl;
-    filenames[ i ] = args.inputs[ i ];
+    string checksum = file_checksum( args.inputs[ i ] );
+    map< string, string >::iterator it = checksums.find( args.inputs[ i ] );
+    if( args.incremental_flag && ( it != checksums.end() ) && ( it->second == checksum ) ){
+      cout << "skipping unchanged file " << args.inputs[ i ] << endl;
+    } else {
+      filenames.push_back( args.inputs[ i ] );
+    }
+    checksums[ args.inputs[ i ] ] = checksum;
+  }
 
-    worlds[ i ] = new World();
-    worlds[ i ]->from_xml( args.inputs[ i ] ); 
-  
-    phrases[ i ] = new Phrase();
-    phrases[ i ]->from_xml( args.inputs[ i ] ); 
+  // each process reads and trains on every processes-th file, the coordinator (rank 0) runs the optimizer
+  Process_Group process_group;
+  unsigned int rank = 0;
+  const vector< string > input_filenames = filenames;
+  if( args.processes_arg > 1 ){
+    rank = process_group.fork( args.processes_arg - 1 );
+    vector< string > process_filenames;
+    for( unsigned int i = rank; i < filenames.size(); i += args.processes_arg ){
+      process_filenames.push_back( filenames[ i ] );
+    }
+    filenames.swap( process_filenames );
+  }
 
-    dcgs[ i ] = new DCG();
-    dcgs[ i ]->fill_search_spaces( worlds[ i ] );
-    
-    scrape_examples( filenames[ i ], phrases[ i ], worlds[ i ], dcgs[ i ]->search_spaces(), dcgs[ i ]->correspondence_variables(), examples );  
+  Telemetry telemetry;
+  if( ( rank == 0 ) && args.telemetry_given && !telemetry.open( args.telemetry_arg ) ){
+    cout << "could not open " << args.telemetry_arg << endl;
+    exit(1);
   }
 
-  cout << "training with " << examples.size() << " examples" << endl;
+  Telemetry report;
+  if( ( rank == 0 ) && args.report_given && !report.open( args.report_arg ) ){
+    cout << "could not open " << args.report_arg << endl;
+    exit(1);
+  }
 
   vector< Feature_Set* > feature_sets;
   for( int i = 0; i < args.threads_arg; i++ ){
     feature_sets.push_back( new Feature_Set() );
-    feature_sets.back()->from_xml( args.feature_set_arg );
+    if( !args.llm_given ){
+      feature_sets.back()->from_xml( args.feature_set_arg );
+    }
+    if( args.hash_size_given ){
+      feature_sets.back()->hash_size() = args.hash_size_arg;
+    }
+  }
+
+  if( args.hash_size_given ){
+    cout << "hashing " << feature_sets.front()->num_features() << " features into " << feature_sets.front()->size() << " weights" << endl;
   }
 
   vector< LLM* > llms;
   for( int i = 0; i < args.threads_arg; i++ ){
     llms.push_back( new LLM( feature_sets[ i ] ) );
-    llms.back()->weights().resize( llms.back()->feature_set()->size() );
+    if( args.llm_given ){
+      if( !llms.back()->from_file( args.llm_arg ) ){
+        cout << "could not read llm from " << args.llm_arg << endl;
+        exit(1);
+      }
+    } else {
+      llms.back()->weights().resize( llms.back()->feature_set()->size() );
+    }
+  }
+
+  if( args.llm_given ){
+    cout << "starting from " << args.llm_arg << " with " << llms.front()->weights().size() << " weights" << endl;
   }
 
   LLM_Train* llm_train = new LLM_Train( llms );
+  if( strcmp( args.optimizer_arg, "sgd" ) == 0 ){
+    llm_train->optimizer() = LLM_TRAIN_OPTIMIZER_SGD;
+  } else if( strcmp( args.optimizer_arg, "adagrad" ) == 0 ){
+    llm_train->optimizer() = LLM_TRAIN_OPTIMIZER_ADAGRAD;
+  } else {
+    llm_train->optimizer() = LLM_TRAIN_OPTIMIZER_LBFGS;
+  }
+  llm_train->batch_size() = args.batch_size_arg;
+  llm_train->learning_rate() = args.learning_rate_arg;
+  llm_train->seed() = args.seed_arg;
+  llm_train->l1() = args.l1_arg;
+  llm_train->deduplicate() = args.deduplicate_flag;
+  llm_train->deterministic() = args.deterministic_flag;
+  llm_train->negatives() = args.negatives_given ? args.negatives_arg : 0;
+  llm_train->hard_negatives() = args.hard_negatives_flag;
+  llm_train->patience() = args.patience_arg;
+  llm_train->holdout_interval() = args.holdout_interval_arg;
+  if( telemetry.is_open() ){
+    llm_train->telemetry() = &telemetry;
+  }
+  if( args.incremental_flag ){
+    llm_train->prior() = llms.front()->weights();
+    llm_train->prior_lambda() = args.prior_lambda_arg;
+  }
+  if( args.index_cache_given ){
+    stringstream index_cache;
+    index_cache << args.index_cache_arg;
+    if( rank > 0 ){
+      index_cache << "." << rank;
+    }
+    llm_train->index_cache() = index_cache.str();
+    llm_train->index_cache_key() = index_cache_key( feature_sets.front(), filenames, checksums );
+  }
 
-  llm_train->train( examples, args.max_iterations_arg, args.lambda_arg, args.epsilon_arg );
+  if( args.out_of_core_given ){
+    stringstream out_of_core;
+    out_of_core << args.out_of_core_arg;
+    if( rank > 0 ){
+      out_of_core << "." << rank;
+    }
+    llm_train->out_of_core() = out_of_core.str();
+  }
+
+  // each file is scraped and indexed before the next one is read, so only the index table grows with the corpus
+  if( !llm_train->clear_examples() ){
+    exit(1);
+  }
+  DCG dcg;
+  vector< pair< unsigned int, unsigned int > > file_ranges;
+  for( unsigned int i = 0; i < filenames.size(); i++ ){
+    cout << "reading file " << filenames[ i ] << endl;
+
+    World * world = new World();
+    world->from_xml( filenames[ i ] ); 
+  
+    Phrase * phrase = new Phrase();
+    phrase->from_xml( filenames[ i ] ); 
+
+    dcg.fill_search_spaces( world );
+    
+    LLM_Example_Set examples;
+    examples.scrape( filenames[ i ], phrase, world, dcg.search_spaces(), dcg.correspondence_variables() );  
+    file_ranges.push_back( pair< unsigned int, unsigned int >( llm_train->num_examples(), llm_train->num_examples() + examples.size() ) );
+    if( !llm_train->add_examples( examples ) ){
+      exit(1);
+    }
+    examples.clear();
+
+    delete phrase;
+    delete world;
+  }
+
+  // the held-out files are the last ones read, so their examples are the tail of the example table
+  if( args.holdout_given ){
+    const unsigned int num_training_files = file_ranges.size() - args.holdout_arg;
+    llm_train->row_ranges().push_back( pair< unsigned int, unsigned int >( 0, file_ranges[ num_training_files ].first ) );
+    llm_train->holdout_ranges().push_back( pair< unsigned int, unsigned int >( file_ranges[ num_training_files ].first, llm_train->num_examples() ) );
+    cout << "holding out " << llm_train->num_examples() - file_ranges[ num_training_files ].first << " examples from " << args.holdout_arg << " files" << endl;
+  }
+
+  if( args.processes_arg > 1 ){
+    cout << "process " << rank << " training with " << llm_train->num_examples() << " examples" << endl;
+  } else {
+    cout << "training with " << llm_train->num_examples() << " examples" << endl;
+  }
+  if( telemetry.is_open() ){
+    telemetry.write( "read", Telemetry_Record().add( "files", filenames.size() ).add( "examples", llm_train->num_examples() ).add( "max_rss_mb", Telemetry::max_rss() ) );
+  }
+
+  if( rank > 0 ){
+    llm_train->verbose() = false;
+    llm_train->process_group() = &process_group;
+    if( !llm_train->prepare() ){
+      exit(1);
+    }
+    llm_train->serve();
+    if( process_group.finished() ){
+      vector< llm_evaluation_t > evaluations;
+      llm_train->evaluate( llms.front(), file_ranges, evaluations );
+      process_group.send( pack_evaluations( llm_train, evaluations ) );
+    }
+    return 0;
+  } else if( process_group.is_coordinator() ){
+    llm_train->process_group() = &process_group;
+  }
+
+  bool trained = true;
+  if( ( llm_train->num_examples() > 0 ) || process_group.is_coordinator() ){
+    if( !llm_train->prepare() ){
+      process_group.stop();
+      exit(1);
+    }
+    if( args.sweep_lambda_given || args.sweep_epsilon_given || args.sweep_l1_given ){
+      trained = sweep( llm_train, args );
+    } else if( args.folds_given ){
+      cross_validate( llm_train, filenames, file_ranges, args );
+
+      cout << "training the final model on all " << llm_train->num_examples() << " examples" << endl;
+      llm_train->optimize( args.max_iterations_arg, args.lambda_arg, args.epsilon_arg );
+
+      evaluate_model( llm_train, llms.front(), filenames, file_ranges, report );
+    } else {
+      llm_train->optimize( args.max_iterations_arg, args.lambda_arg, args.epsilon_arg );
  
-  evaluate_model( llms.front(), examples );
+      if( process_group.is_coordinator() ){
+        evaluate_process_group( llm_train, llms.front(), input_filenames, file_ranges, process_group, report );
+      } else {
+        evaluate_model( llm_train, llms.front(), filenames, file_ranges, report );
+      }
+    }
+    if( args.dump_examples_flag ){
+      dump_examples( filenames, llms.front() );
+    }
+  } else {
+    cout << "no new or changed examples, keeping the weights of " << args.llm_arg << endl;
+  }
+
+  if( args.prune_given && trained ){
+    unsigned int num_pruned = llms.front()->prune( args.prune_arg );
+    cout << "pruned " << num_pruned << " weights" << endl;
+  }
 
-  if( args.output_given ){
-    llms.front()->to_xml( args.output_arg );
+  if( trained ){
+    unsigned int num_nonzero = 0;
+    for( unsigned int i = 0; i < llms.front()->weights().size(); i++ ){
+      if( llms.front()->weights()[ i ] != 0.0 ){
+        num_nonzero++;
+      }
+    }
+    cout << num_nonzero << " of " << llms.front()->weights().size() << " weights are nonzero" << endl;
+
+    if( args.output_given ){
+      write_model( llms.front(), checksums, args.output_arg );
+    }
   }
 
   for( unsigned int i = 0; i < llms.size(); i++ ){
@@ -0,0 +1,518 @@
+/**
+ * @file    llm_train_test.cc
+ * @author  Thomas M. Howard (tmhoward@csail.mit.edu)
+ *          Matthew R. Walter (mwalter@csail.mit.edu)
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This file is part of h2sl.
+ *
+ * Copyright (C) 2014 by the Massachusetts Institute of Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/gpl-2.0.html> or write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * @section DESCRIPTION
+ *
+ * A LLM_Train class test program
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cstdio>
+
+#include "h2sl/common.h"
+#include "h2sl/cv.h"
+#include "h2sl/llm.h"
+#include "h2sl/dcg.h"
+#include "llm_train_test_cmdline.h"
+
+using namespace std;
+using namespace h2sl;
+
+/**
+ * a trainer with one model and feature set per thread and the ranges of examples read from each file
+ */
+typedef struct {
+  vector< Feature_Set* > feature_sets;
+  vector< LLM* > llms;
+  LLM_Train * llm_train;
+  vector< pair< unsigned int, unsigned int > > file_ranges;
+} trainer_t;
+
+/**
+ * creates a quiet trainer with one model per thread over the feature set
+ */
+void
+create_trainer( const string& featureSetFilename,
+                const unsigned int& numThreads,
+                trainer_t& trainer ){
+  for( unsigned int i = 0; i < numThreads; i++ ){
+    trainer.feature_sets.push_back( new Feature_Set() );
+    trainer.feature_sets.back()->from_xml( featureSetFilename );
+    trainer.llms.push_back( new LLM( trainer.feature_sets.back() ) );
+    trainer.llms.back()->weights().resize( trainer.feature_sets.back()->size() );
+  }
+  trainer.llm_train = new LLM_Train( trainer.llms );
+  trainer.llm_train->verbose() = false;
+  trainer.file_ranges.clear();
+  return;
+}
+
+void
+destroy_trainer( trainer_t& trainer ){
+  if( trainer.llm_train != NULL ){
+    delete trainer.llm_train;
+    trainer.llm_train = NULL;
+  }
+  for( unsigned int i = 0; i < trainer.llms.size(); i++ ){
+    delete trainer.llms[ i ];
+    delete trainer.feature_sets[ i ];
+  }
+  trainer.llms.clear();
+  trainer.feature_sets.clear();
+  trainer.file_ranges.clear();
+  return;
+}
+
+/**
+ * reads and indexes the examples of each file the way llm_train does, remembering the range of rows of each file
+ */
+bool
+read_examples( const vector< string >& filenames,
+                trainer_t& trainer ){
+  if( !trainer.llm_train->clear_examples() ){
+    return false;
+  }
+  DCG dcg;
+  for( unsigned int i = 0; i < filenames.size(); i++ ){
+    World * world = new World();
+    world->from_xml( filenames[ i ] );
+
+    Phrase * phrase = new Phrase();
+    phrase->from_xml( filenames[ i ] );
+
+    dcg.fill_search_spaces( world );
+
+    LLM_Example_Set examples;
+    examples.scrape( filenames[ i ], phrase, world, dcg.search_spaces(), dcg.correspondence_variables() );
+    trainer.file_ranges.push_back( pair< unsigned int, unsigned int >( trainer.llm_train->num_examples(), trainer.llm_train->num_examples() + examples.size() ) );
+    bool added = trainer.llm_train->add_examples( examples );
+
+    delete phrase;
+    delete world;
+    if( !added ){
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * checks that two vectors of weights are bitwise identical and prints the first difference
+ */
+bool
+identical( const vector< double >& first,
+            const vector< double >& second ){
+  if( first.size() != second.size() ){
+    cout << "  " << first.size() << " weights differ from " << second.size() << " weights" << endl;
+    return false;
+  }
+  for( unsigned int i = 0; i < first.size(); i++ ){
+    if( memcmp( &first[ i ], &second[ i ], sizeof( double ) ) != 0 ){
+      cout << "  weight " << i << " is " << setprecision( 17 ) << first[ i ] << " instead of " << second[ i ] << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * fills the weights with reproducible values in [-1,1]
+ */
+void
+fill_weights( vector< double >& weights,
+              const unsigned int& seed ){
+  srand( seed );
+  for( unsigned int i = 0; i < weights.size(); i++ ){
+    weights[ i ] = 2.0 * ( double )( rand() ) / ( double )( RAND_MAX ) - 1.0;
+  }
+  return;
+}
+
+/**
+ * checks that an objective and gradient match the expected ones up to the rounding of a different summation order
+ */
+bool
+close( const double& objective,
+        const vector< double >& gradient,
+        const double& expectedObjective,
+        const vector< double >& expectedGradient ){
+  const double tolerance = 1e-9;
+  if( fabs( objective - expectedObjective ) > tolerance * max( 1.0, fabs( expectedObjective ) ) ){
+    cout << "  objective " << setprecision( 17 ) << objective << " instead of " << expectedObjective << endl;
+    return false;
+  }
+  if( gradient.size() != expectedGradient.size() ){
+    cout << "  " << gradient.size() << " gradient entries instead of " << expectedGradient.size() << endl;
+    return false;
+  }
+  double scale = 1.0;
+  for( unsigned int i = 0; i < expectedGradient.size(); i++ ){
+    scale = max( scale, fabs( expectedGradient[ i ] ) );
+  }
+  for( unsigned int i = 0; i < gradient.size(); i++ ){
+    if( fabs( gradient[ i ] - expectedGradient[ i ] ) > tolerance * scale ){
+      cout << "  gradient " << i << " is " << setprecision( 17 ) << gradient[ i ] << " instead of " << expectedGradient[ i ] << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * checks that training with the deterministic reductions gives bitwise identical weights on one thread and on numThreads threads
+ */
+bool
+test_deterministic( const string& featureSetFilename,
+                    const vector< string >& filenames,
+                    const llm_train_optimizer_t& optimizer,
+                    const unsigned int& numThreads,
+                    const unsigned int& maxIterations ){
+  vector< double > weights[ 2 ];
+  double objectives[ 2 ] = { 0.0, 0.0 };
+  const unsigned int threads[ 2 ] = { 1, numThreads };
+  for( unsigned int i = 0; i < 2; i++ ){
+    trainer_t trainer;
+    create_trainer( featureSetFilename, threads[ i ], trainer );
+    trainer.llm_train->deterministic() = true;
+    trainer.llm_train->optimizer() = optimizer;
+    if( !read_examples( filenames, trainer ) || !trainer.llm_train->prepare() ){
+      destroy_trainer( trainer );
+      return false;
+    }
+    trainer.llm_train->optimize( maxIterations, 0.001, 0.001 );
+    weights[ i ] = trainer.llms.front()->weights();
+    objectives[ i ] = trainer.llm_train->final_objective();
+    destroy_trainer( trainer );
+  }
+
+  if( memcmp( &objectives[ 0 ], &objectives[ 1 ], sizeof( double ) ) != 0 ){
+    cout << "  objective " << setprecision( 17 ) << objectives[ 1 ] << " on " << numThreads << " threads instead of " << objectives[ 0 ] << endl;
+    return false;
+  }
+  return identical( weights[ 1 ], weights[ 0 ] );
+}
+
+/**
+ * checks each fold of cross-validation the way llm_train sets it up: a copy of the trainer of every 
+ * file restricted to the rows of the training files must see the same objective and gradient as a 
+ * trainer of just those files, and its held-out rows must count as many correct examples as a 
+ * trainer of just the held-out files
+ */
+bool
+test_folds( const string& featureSetFilename,
+            const vector< string >& filenames,
+            const unsigned int& numFolds,
+            const unsigned int& numThreads ){
+  trainer_t prototype;
+  create_trainer( featureSetFilename, numThreads, prototype );
+  if( !read_examples( filenames, prototype ) || !prototype.llm_train->prepare() ){
+    destroy_trainer( prototype );
+    return false;
+  }
+
+  bool passed = true;
+  for( unsigned int fold = 0; passed && ( fold < numFolds ); fold++ ){
+    vector< string > training_filenames;
+    vector< string > test_filenames;
+    vector< pair< unsigned int, unsigned int > > training_ranges;
+    vector< pair< unsigned int, unsigned int > > test_ranges;
+    for( unsigned int i = 0; i < filenames.size(); i++ ){
+      if( i % numFolds == fold ){
+        test_filenames.push_back( filenames[ i ] );
+        test_ranges.push_back( prototype.file_ranges[ i ] );
+      } else {
+        training_filenames.push_back( filenames[ i ] );
+        training_ranges.push_back( prototype.file_ranges[ i ] );
+      }
+    }
+
+    LLM llm( prototype.llms.front()->feature_set() );
+    llm.weights().resize( prototype.llms.front()->weights().size() );
+    fill_weights( llm.weights(), fold + 1 );
+
+    LLM_Train llm_train( *prototype.llm_train );
+    llm_train.llms() = vector< LLM* >( 1, &llm );
+    llm_train.row_ranges() = training_ranges;
+    llm_train.partition( 1 );
+    double objective = llm_train.objective_and_gradient( 0.0 );
+
+    trainer_t training;
+    create_trainer( featureSetFilename, 1, training );
+    if( !read_examples( training_filenames, training ) || !training.llm_train->prepare() ){
+      destroy_trainer( training );
+      passed = false;
+      break;
+    }
+    training.llms.front()->weights() = llm.weights();
+    double expected_objective = training.llm_train->objective_and_gradient( 0.0 );
+    passed = close( objective, llm_train.gradient(), expected_objective, training.llm_train->gradient() );
+    destroy_trainer( training );
+
+    trainer_t test;
+    create_trainer( featureSetFilename, 1, test );
+    if( !read_examples( test_filenames, test ) || !test.llm_train->prepare() ){
+      destroy_trainer( test );
+      passed = false;
+      break;
+    }
+    double num_correct = 0.0;
+    for( unsigned int i = 0; i < test_ranges.size(); i++ ){
+      num_correct += llm_train.num_correct( &llm, test_ranges[ i ].first, test_ranges[ i ].second );
+    }
+    double expected_num_correct = test.llm_train->num_correct( &llm, 0, test.llm_train->indices().num_rows() );
+    if( num_correct != expected_num_correct ){
+      cout << "  fold " << fold << " counted " << num_correct << " correct held-out examples instead of " << expected_num_correct << endl;
+      passed = false;
+    }
+    destroy_trainer( test );
+  }
+
+  destroy_trainer( prototype );
+  return passed;
+}
+
+/**
+ * checks that merging duplicates of a set of files read twice leaves at most half of the rows 
+ * without changing the objective or the gradient
+ */
+bool
+test_deduplicate( const string& featureSetFilename,
+                  const vector< string >& filenames,
+                  const unsigned int& numThreads ){
+  vector< string > twice = filenames;
+  twice.insert( twice.end(), filenames.begin(), filenames.end() );
+
+  trainer_t trainers[ 2 ];
+  create_trainer( featureSetFilename, numThreads, trainers[ 0 ] );
+  create_trainer( featureSetFilename, numThreads, trainers[ 1 ] );
+  trainers[ 1 ].llm_train->deduplicate() = true;
+
+  double objectives[ 2 ] = { 0.0, 0.0 };
+  bool passed = true;
+  for( unsigned int i = 0; passed && ( i < 2 ); i++ ){
+    if( !read_examples( twice, trainers[ i ] ) || !trainers[ i ].llm_train->prepare() ){
+      passed = false;
+      break;
+    }
+    for( unsigned int j = 0; j < trainers[ i ].llms.size(); j++ ){
+      fill_weights( trainers[ i ].llms[ j ]->weights(), 1 );
+    }
+    objectives[ i ] = trainers[ i ].llm_train->objective_and_gradient( 0.0 );
+  }
+
+  if( passed ){
+    const unsigned int num_rows = trainers[ 0 ].llm_train->indices().num_rows();
+    const unsigned int num_merged_rows = trainers[ 1 ].llm_train->indices().num_rows();
+    if( ( trainers[ 1 ].llm_train->num_examples() != trainers[ 0 ].llm_train->num_examples() ) || ( 2 * num_merged_rows > num_rows ) ){
+      cout << "  merged " << num_rows << " rows into " << num_merged_rows << " rows" << endl;
+      passed = false;
+    } else {
+      passed = close( objectives[ 1 ], trainers[ 1 ].llm_train->gradient(), objectives[ 0 ], trainers[ 0 ].llm_train->gradient() );
+    }
+  }
+
+  destroy_trainer( trainers[ 0 ] );
+  destroy_trainer( trainers[ 1 ] );
+  return passed;
+}
+
+/**
+ * checks early stopping on the last file: with a patience that never stops training early, the 
+ * weights kept by the held-out evaluation must score the held-out rows at least as well as the 
+ * weights of the last iteration of the same training run without a held-out set
+ */
+bool
+test_holdout( const string& featureSetFilename,
+              const vector< string >& filenames,
+              const unsigned int& numThreads,
+              const unsigned int& maxIterations ){
+  trainer_t trainers[ 2 ];
+  create_trainer( featureSetFilename, numThreads, trainers[ 0 ] );
+  create_trainer( featureSetFilename, numThreads, trainers[ 1 ] );
+
+  vector< llm_evaluation_t > evaluations[ 2 ];
+  vector< pair< unsigned int, unsigned int > > holdout_ranges;
+  bool passed = true;
+  for( unsigned int i = 0; passed && ( i < 2 ); i++ ){
+    if( !read_examples( filenames, trainers[ i ] ) ){
+      passed = false;
+      break;
+    }
+    holdout_ranges.assign( 1, trainers[ i ].file_ranges.back() );
+    trainers[ i ].llm_train->row_ranges().push_back( pair< unsigned int, unsigned int >( 0, holdout_ranges.front().first ) );
+    if( i == 1 ){
+      trainers[ i ].llm_train->holdout_ranges() = holdout_ranges;
+      trainers[ i ].llm_train->patience() = maxIterations;
+      trainers[ i ].llm_train->holdout_interval() = 1;
+    }
+    if( !trainers[ i ].llm_train->prepare() ){
+      passed = false;
+      break;
+    }
+    trainers[ i ].llm_train->optimize( maxIterations, 0.001, 0.001 );
+    trainers[ i ].llm_train->evaluate( trainers[ i ].llms.front(), holdout_ranges, evaluations[ i ] );
+  }
+
+  if( passed ){
+    const llm_evaluation_t& last = evaluations[ 0 ].front();
+    const llm_evaluation_t& best = evaluations[ 1 ].front();
+    if( ( best.num_examples != last.num_examples ) || ( best.num_examples == 0.0 ) ){
+      cout << "  evaluated " << best.num_examples << " instead of " << last.num_examples << " held-out examples" << endl;
+      passed = false;
+    } else if( best.log_loss > last.log_loss * ( 1.0 + 1e-9 ) ){
+      cout << "  kept weights with held-out log-loss " << setprecision( 17 ) << best.log_loss << " over the last weights with " << last.log_loss << endl;
+      passed = false;
+    }
+  }
+
+  destroy_trainer( trainers[ 0 ] );
+  destroy_trainer( trainers[ 1 ] );
+  return passed;
+}
+
+/**
+ * checks that training over index shards written under prefix and mapped back gives bitwise the weights of training in memory
+ */
+bool
+test_out_of_core( const string& featureSetFilename,
+                  const vector< string >& filenames,
+                  const string& prefix,
+                  const unsigned int& numThreads,
+                  const unsigned int& maxIterations ){
+  vector< double > weights[ 2 ];
+  double objectives[ 2 ] = { 0.0, 0.0 };
+  bool passed = true;
+  for( unsigned int i = 0; passed && ( i < 2 ); i++ ){
+    trainer_t trainer;
+    create_trainer( featureSetFilename, numThreads, trainer );
+    if( i == 1 ){
+      trainer.llm_train->out_of_core() = prefix;
+    }
+    if( !read_examples( filenames, trainer ) || !trainer.llm_train->prepare() ){
+      passed = false;
+    } else if( trainer.llm_train->indices().mapped() != ( i == 1 ) ){
+      cout << "  the indices are " << ( trainer.llm_train->indices().mapped() ? "" : "not " ) << "mapped" << endl;
+      passed = false;
+    } else {
+      trainer.llm_train->optimize( maxIterations, 0.001, 0.001 );
+      weights[ i ] = trainer.llms.front()->weights();
+      objectives[ i ] = trainer.llm_train->final_objective();
+    }
+    destroy_trainer( trainer );
+  }
+
+  for( unsigned int array = 0; array < 3; array++ ){
+    unsigned int shard = 0;
+    while( remove( LLM_Index_Table_Writer::filename( prefix, array, shard ).c_str() ) == 0 ){
+      shard++;
+    }
+  }
+
+  if( !passed ){
+    return false;
+  }
+  if( memcmp( &objectives[ 0 ], &objectives[ 1 ], sizeof( double ) ) != 0 ){
+    cout << "  objective " << setprecision( 17 ) << objectives[ 1 ] << " out of core instead of " << objectives[ 0 ] << endl;
+    return false;
+  }
+  return identical( weights[ 1 ], weights[ 0 ] );
+}
+
+int
+main( int argc,
+      char* argv[] ) {
+  int status = 0;
+  cout << "start of LLM_Train class test program" << endl;
+
+  gengetopt_args_info args;
+  if( cmdline_parser( argc, argv, &args ) != 0 ){
+    exit(1);
+  }
+
+  if( ( args.threads_arg < 1 ) || ( args.max_iterations_arg < 1 ) || ( args.folds_arg < 2 ) || ( args.inputs_num < 2 ) ){
+    cout << "--threads and --max_iterations must be positive, --folds at least two and at least two example files are needed" << endl;
+    exit(1);
+  }
+
+  vector< string > filenames;
+  for( unsigned int i = 0; i < args.inputs_num; i++ ){
+    filenames.push_back( args.inputs[ i ] );
+  }
+
+  const llm_train_optimizer_t optimizers[ 3 ] = { LLM_TRAIN_OPTIMIZER_LBFGS, LLM_TRAIN_OPTIMIZER_SGD, LLM_TRAIN_OPTIMIZER_ADAGRAD };
+  const char* optimizer_names[ 3 ] = { "lbfgs", "sgd", "adagrad" };
+  for( unsigned int i = 0; i < 3; i++ ){
+    cout << "training deterministically with " << optimizer_names[ i ] << " on 1 and " << args.threads_arg << " threads" << endl;
+    if( test_deterministic( args.feature_set_arg, filenames, optimizers[ i ], args.threads_arg, args.max_iterations_arg ) ){
+      cout << "  passed" << endl;
+    } else {
+      cout << "  failed" << endl;
+      status = 1;
+    }
+  }
+
+  const unsigned int num_folds = min( ( unsigned int )( args.folds_arg ), args.inputs_num );
+  cout << "checking " << num_folds << " cross-validation folds" << endl;
+  if( test_folds( args.feature_set_arg, filenames, num_folds, args.threads_arg ) ){
+    cout << "  passed" << endl;
+  } else {
+    cout << "  failed" << endl;
+    status = 1;
+  }
+
+  cout << "merging the duplicates of the example files read twice" << endl;
+  if( test_deduplicate( args.feature_set_arg, filenames, args.threads_arg ) ){
+    cout << "  passed" << endl;
+  } else {
+    cout << "  failed" << endl;
+    status = 1;
+  }
+
+  cout << "keeping the best weights on the held-out file " << filenames.back() << endl;
+  if( test_holdout( args.feature_set_arg, filenames, args.threads_arg, args.max_iterations_arg ) ){
+    cout << "  passed" << endl;
+  } else {
+    cout << "  failed" << endl;
+    status = 1;
+  }
+
+  cout << "training over mapped index shards under " << args.output_arg << endl;
+  if( test_out_of_core( args.feature_set_arg, filenames, args.output_arg, args.threads_arg, args.max_iterations_arg ) ){
+    cout << "  passed" << endl;
+  } else {
+    cout << "  failed" << endl;
+    status = 1;
+  }
+
+  cout << "end of LLM_Train class test program" << endl;
+  return status;
+}